@@ -1,46 +1,64 @@
-#ifndef ANTIVIRUS_H
-#define ANTIVIRUS_H
-
-#include <QDialog>
-#include <QMap>
-#include <QStringList>
-#include "antivirusscanner.h"
-
-namespace Ui {
-class Antivirus;
-}
-
-class Antivirus : public QDialog
-{
-    Q_OBJECT
-
-public:
-    explicit Antivirus(QWidget *parent = nullptr);
-    ~Antivirus();
-
-private slots:
-    void onScanClicked();
-    void onDeleteClicked();
-    void onDeleteAllClicked();
-    void onScanProgress(int current, int total);
-    void onThreatFound(QString fileName, QString threatName);
-    void onScanComplete();
-
-private:
-    Ui::Antivirus *ui;
-    AntivirusScanner *scanner;
-
-    // ClamAV engine
-    struct cl_engine *clamEngine;
-
-    QMap<QString, QString> virusSignatures;
-    QStringList infectedFiles;
-    int totalScanned;
-
-    void loadSignatures();
-    void initializeClamAV();
-    void cleanupClamAV();
-    QStringList getAllFilesRecursive(const QString &path);
-};
-
-#endif // ANTIVIRUS_H
+#ifndef ANTIVIRUS_H
+#define ANTIVIRUS_H
+
+#include <QDialog>
+#include <QPointer>
+#include <QSortFilterProxyModel>
+#include <QTimer>
+#include <QStringList>
+#include "scanjob.h"
+#include "engineservice.h"
+#include "scandaemonclient.h"
+#include "scanresultmodel.h"
+
+namespace Ui {
+class Antivirus;
+}
+
+class Antivirus : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit Antivirus(EngineService *engines, QWidget *parent = nullptr);
+    ~Antivirus();
+
+private slots:
+    void onScanClicked();
+    void onDeleteClicked();
+    void onDeleteAllClicked();
+    void updateProgress();
+    void onDiscoveryComplete(int total);
+    void onVerdictCacheStats(int hits, int misses);
+    void onDuplicatesSkipped(int count);
+    void onScanErrors(int count);
+    void onScanFailed(const QString& message);
+    void onScanComplete();
+    void onEngineStateChanged(EngineService::State state);
+    void onUpdateClicked();
+
+private:
+    Ui::Antivirus *ui;
+    // In nehnes-scand when it is running, otherwise in this process
+    QPointer<ScanJob> scanner;
+    // Samples the scanner's progress counters while a scan runs
+    QTimer progressTimer;
+
+    // Shared with the rest of the application; owns the loaded engine.
+    // Only loaded when there is no daemon to scan with.
+    EngineService *engines;
+
+    ScanResultModel *results;
+    QSortFilterProxyModel *filteredResults;
+    qint64 totalScanned;
+    bool discoveryFinished;
+    int cacheHits;
+    int cacheMisses;
+    int duplicateFiles;
+    int scanErrors;
+
+    void collectResults();
+    void deleteFiles(const QStringList& filePaths, int& deletedCount, int& failedCount);
+};
+
+#endif // ANTIVIRUS_H
@@ -1,72 +1,367 @@
-#include "antivirusscanner.h"
-#include <QFile>
-#include <QThread>
-
-AntivirusScanner::AntivirusScanner(const QStringList& filesToScan,
-                                   struct cl_engine *engine,
-                                   QObject *parent)
-    : QThread(parent)
-    , files(filesToScan)
-    , clamEngine(engine)
-{
-}
-
-void AntivirusScanner::run()
-{
-    int total = files.size();
-
-    for (int i = 0; i < total; ++i) {
-        if (isInterruptionRequested()) {
-            break;
-        }
-
-        emit scanProgress(i + 1, total);
-
-        QString detectedThreat;
-        if (scanFileWithClamAV(files[i], detectedThreat)) {
-            emit threatFound(files[i], detectedThreat);
-        }
-
-        // Small delay to prevent overwhelming the UI
-        QThread::msleep(1);
-    }
-
-    emit scanComplete();
-}
-
-bool AntivirusScanner::scanFileWithClamAV(const QString& filePath, QString& detectedThreat)
-{
-    if (!clamEngine) {
-        // Fallback to basic EICAR detection if ClamAV not available
-        QFile file(filePath);
-        if (!file.open(QIODevice::ReadOnly)) {
-            return false;
-        }
-
-        QByteArray fileData = file.readAll();
-        file.close();
-
-        QString eicarSignature = "X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*";
-        if (fileData.contains(eicarSignature.toUtf8())) {
-            detectedThreat = "EICAR-Test";
-            return true;
-        }
-        return false;
-    }
-
-    // Use ClamAV to scan the file
-    const char *virname = nullptr;
-    unsigned long int scanned = 0;
-
-    struct cl_scan_options options = {};
-    options.general = CL_SCAN_GENERAL_ALLMATCHES;
-    options.parse = ~0u;
-    cl_error_t ret = cl_scanfile(filePath.toUtf8().constData(), &virname, &scanned, clamEngine, &options);
-
-    if (ret == CL_VIRUS) {
-        detectedThreat = QString::fromUtf8(virname);
-        return true;
-    }
-
-    return false;
-}
+#include "antivirusscanner.h"
+#include "bufferpool.h"
+#include "directorywalker.h"
+#include "filechunkreader.h"
+#include "scanfilehandle.h"
+#include "scanqueue.h"
+#include <QDateTime>
+#include <QFile>
+#include <QThread>
+
+namespace {
+
+// Waits for a set of pipeline threads, running onStop as soon as a stop is
+// requested so threads parked on a queue are woken up
+template <typename StopFn>
+void joinThreads(QList<QThread*>& threads, const QThread *owner, StopFn onStop)
+{
+    for (QThread *thread : threads) {
+        while (!thread->wait(100)) {
+            if (owner->isInterruptionRequested()) {
+                onStop();
+            }
+        }
+        delete thread;
+    }
+    threads.clear();
+}
+
+}
+
+AntivirusScanner::AntivirusScanner(const QStringList& pathsToScan,
+                                   EngineService *engines,
+                                   QObject *parent)
+    : ScanJob(parent)
+    , paths(pathsToScan)
+    , engines(engines)
+    , workerCount(QThread::idealThreadCount())
+    , readerCount(qBound(2, QThread::idealThreadCount() / 2, 8))
+    , readBufferSize(4 * 1024 * 1024)
+    , chunkSize(FileChunkReader::defaultChunkSize())
+    , walkerMethod(DirectoryWalker::defaultMethod())
+    , walkerThreads(DirectoryWalker::defaultThreadCount())
+    , pending(nullptr)
+    , results(16384)
+{
+}
+
+void AntivirusScanner::setThreadCount(int count)
+{
+    workerCount = count;
+}
+
+int AntivirusScanner::threadCount() const
+{
+    return workerCount;
+}
+
+void AntivirusScanner::setReaderThreadCount(int count)
+{
+    readerCount = count;
+}
+
+int AntivirusScanner::readerThreadCount() const
+{
+    return readerCount;
+}
+
+void AntivirusScanner::setReadBufferSize(qint64 bytes)
+{
+    readBufferSize = bytes;
+}
+
+void AntivirusScanner::setChunkSize(qint64 bytes)
+{
+    chunkSize = bytes;
+}
+
+void AntivirusScanner::setWalkerMethod(DirectoryWalker::Method method)
+{
+    walkerMethod = method;
+}
+
+void AntivirusScanner::setWalkerThreadCount(int count)
+{
+    walkerThreads = count;
+}
+
+void AntivirusScanner::run()
+{
+    filesDone.storeRelaxed(0);
+    bytesDone.storeRelaxed(0);
+    errorCount.storeRelaxed(0);
+    // Keeps the engine from being evicted for idleness while we scan
+    engines->beginScan();
+
+    int readers = qMax(1, readerCount);
+    // A compiled cl_engine is read-only during scanning, so every worker
+    // can share it without locking.
+    int workers = qMax(1, workerCount);
+
+    // Enough buffers to keep every worker busy while the readers fill more
+    ScanQueue queue(readers);
+    BufferPool buffers(workers + readers, readBufferSize);
+    // Workers take the largest file on hand first, as the readers do from
+    // the scan queue, so the big ones (scanned from disk, not from a
+    // buffer) start early and small files fill in behind them. All workers
+    // share this one queue, so none sits idle while anything is waiting.
+    BlockingQueue<LoadedFile> loaded(workers + readers, [](const LoadedFile& a, const LoadedFile& b) {
+        return a.id.size > b.id.size;
+    });
+    {
+        QMutexLocker locker(&pendingMutex);
+        pending = &queue;
+    }
+
+    auto stopAll = [&queue, &buffers, &loaded] {
+        queue.abort();
+        buffers.abort();
+        loaded.abort();
+    };
+
+    QThread *walker = QThread::create([this, &queue] {
+        DirectoryWalker directories(paths, &queue);
+        directories.setMethod(walkerMethod);
+        directories.setThreadCount(walkerThreads);
+        directories.walk();
+        errorCount.fetchAndAddRelaxed(directories.errors());
+        emit discoveryComplete(queue.discovered());
+    });
+    walker->start();
+
+    // An engine that was unloaded while idle is reloaded on demand; the
+    // walk is already under way meanwhile
+    int generation = 0;
+    QSharedPointer<ScanEngine> engine;
+    while (!engine && !isInterruptionRequested()) {
+        engine = engines->waitForEngine(&generation, 100);
+    }
+
+    if (engine) {
+        // Verdicts are filed under the engine the scan started with. If the
+        // signatures are reloaded mid-scan the next run sees a new version
+        // and drops them, so nothing cleared by the old database outlives it.
+        verdictCache.load(engine->version());
+
+        QList<QThread*> readerThreads;
+        for (int i = 0; i < readers; ++i) {
+            QThread *reader = QThread::create([this, &queue, i, &loaded, &buffers] {
+                readWorker(&queue, i, &loaded, &buffers);
+            });
+            readerThreads.append(reader);
+            reader->start();
+        }
+
+        QList<QThread*> workerThreads;
+        for (int i = 0; i < workers; ++i) {
+            QThread *worker = QThread::create([this, &loaded, &buffers, engine, generation] {
+                scanWorker(&loaded, &buffers, engine, generation);
+            });
+            workerThreads.append(worker);
+            worker->start();
+        }
+
+        joinThreads(readerThreads, this, stopAll);
+        loaded.close();
+        joinThreads(workerThreads, this, stopAll);
+
+        verdictCache.save();
+        engine.reset();
+    }
+
+    // Everything downstream is done; unblock the walker if we stopped early
+    queue.abort();
+    walker->wait();
+    delete walker;
+    {
+        QMutexLocker locker(&pendingMutex);
+        pending = nullptr;
+    }
+    engines->endScan();
+
+    emit verdictCacheStats(verdictCache.hits(), verdictCache.misses());
+    emit duplicatesSkipped(dedup.duplicates());
+    emit scanErrors(errorCount.loadRelaxed());
+    emit scanComplete();
+}
+
+void AntivirusScanner::readWorker(ScanQueue *queue, int readerId,
+                                  BlockingQueue<LoadedFile> *loaded, BufferPool *buffers)
+{
+    ScanItem item;
+
+    while (!isInterruptionRequested() && queue->pop(readerId, item)) {
+        LoadedFile file;
+        file.path = item.path;
+        // Stat before reading, so a file changed mid-scan gets a new
+        // identity and is picked up again on the next run
+        file.id = FileIdentity::of(item.path);
+
+        if (verdictCache.isKnownClean(file.id)) {
+            fileDone(file.path, file.id.size);
+            continue;
+        }
+
+        if (file.id.valid && file.id.size <= buffers->bufferSize()) {
+            file.buffer = buffers->acquire();
+            if (!file.buffer) {
+                break;
+            }
+            if (!loadFile(file.path, file.buffer, file.length)) {
+                // Unreadable or grew past the buffer: let the engine try it from disk
+                buffers->release(file.buffer);
+                file.buffer = nullptr;
+            }
+        }
+
+        if (!loaded->push(file)) {
+            buffers->release(file.buffer);
+            break;
+        }
+    }
+}
+
+bool AntivirusScanner::loadFile(const QString& filePath, QByteArray *buffer, qint64& length)
+{
+    // The contents live in our buffer from here on, so the handle drops
+    // the pages it pulled in as soon as the read is done
+    ScanFileHandle handle(filePath);
+    QFile file(filePath);
+    bool opened = handle.open()
+        ? file.open(handle.descriptor(), QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::DontCloseHandle)
+        : file.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    if (!opened) {
+        return false;
+    }
+
+    length = 0;
+    const qint64 capacity = buffer->size();
+    while (length < capacity) {
+        qint64 got = file.read(buffer->data() + length, capacity - length);
+        if (got < 0) {
+            return false;
+        }
+        if (got == 0) {
+            return true;
+        }
+        length += got;
+    }
+
+    // Buffer full: only fine if the file really ends here
+    char probe;
+    return file.read(&probe, 1) == 0;
+}
+
+void AntivirusScanner::scanWorker(BlockingQueue<LoadedFile> *loaded, BufferPool *buffers,
+                                  QSharedPointer<ScanEngine> engine, int generation)
+{
+    LoadedFile file;
+
+    while (!isInterruptionRequested() && loaded->pop(file)) {
+        // This worker's reference to the engine is refreshed only when the
+        // service has published a new one, so the common case is one atomic
+        // load per file; the old engine is freed once the last worker lets
+        // go of it.
+        if (engines->generation() != generation) {
+            QSharedPointer<ScanEngine> latest = engines->engine(&generation);
+            if (latest) {
+                engine = latest;
+            }
+        }
+        scanFile(file, *engine);
+        buffers->release(file.buffer);
+        fileDone(file.path, file.id.size);
+    }
+}
+
+void AntivirusScanner::fileDone(const QString& filePath, qint64 size)
+{
+    filesDone.fetchAndAddRelaxed(1);
+    bytesDone.fetchAndAddRelaxed(qMax<qint64>(0, size));
+
+    if (pathWanted.loadRelaxed() && pathWanted.testAndSetRelaxed(1, 0)) {
+        QMutexLocker locker(&pathMutex);
+        currentPath = filePath;
+    }
+}
+
+void AntivirusScanner::reportThreat(const QString& filePath, const QString& threatName, qint64 size)
+{
+    Result result;
+    result.path = filePath;
+    result.threatName = threatName;
+    result.size = size;
+    result.detectedAt = QDateTime::currentMSecsSinceEpoch();
+
+    // Blocks while the UI is behind; a stopped scan drops what is left
+    results.push(std::move(result), [this] { return isInterruptionRequested(); });
+}
+
+int AntivirusScanner::takeResults(QVector<Result>& out, int max)
+{
+    return results.drain(out, max);
+}
+
+AntivirusScanner::Progress AntivirusScanner::progress() const
+{
+    Progress snapshot;
+    snapshot.files = filesDone.loadRelaxed();
+    snapshot.bytes = bytesDone.loadRelaxed();
+
+    {
+        QMutexLocker locker(&pendingMutex);
+        snapshot.discovered = pending ? pending->discovered() : int(snapshot.files);
+    }
+
+    {
+        QMutexLocker locker(&pathMutex);
+        snapshot.currentPath = currentPath;
+    }
+    pathWanted.storeRelaxed(1);
+
+    return snapshot;
+}
+
+void AntivirusScanner::scanFile(const LoadedFile& file, const ScanEngine& engine)
+{
+    QByteArray fingerprint;
+    ContentDeduplicator::Verdict verdict;
+
+    // Non-owning view of the prefetched contents, if there are any
+    QByteArray contents;
+    if (file.buffer) {
+        contents = QByteArray::fromRawData(file.buffer->constData(), file.length);
+    }
+
+    // A file that did not fit a buffer is opened once, here: a duplicate
+    // check and the scan then share the descriptor, so the second pass is
+    // served from the page cache and the pages are only dropped at the end
+    ScanFileHandle handle(file.path);
+    int fd = (!file.buffer && handle.open()) ? handle.descriptor() : -1;
+
+    // Identical contents were already scanned in this run; reuse the
+    // verdict but still report every infected copy
+    if (!dedup.lookup(file.path, file.id, fingerprint, verdict, file.buffer ? &contents : nullptr, fd)) {
+        bool completed = false;
+        // The reader thread already did the I/O for files in a buffer, so
+        // this worker only spends CPU time on them
+        if (file.buffer) {
+            verdict.infected = engine.scanData(contents, file.path, verdict.threatName, &completed);
+        } else if (fd >= 0) {
+            verdict.infected = engine.scanDescriptor(fd, file.path, verdict.threatName, &completed, chunkSize);
+        } else {
+            verdict.infected = engine.scanFile(file.path, verdict.threatName, &completed, chunkSize);
+        }
+        if (!verdict.infected && !completed) {
+            errorCount.ref();
+            return;
+        }
+        dedup.record(file.path, file.id, fingerprint, verdict);
+    }
+
+    if (verdict.infected) {
+        reportThreat(file.path, verdict.threatName, file.id.size);
+    } else {
+        verdictCache.markClean(file.id);
+    }
+}
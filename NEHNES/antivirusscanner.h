@@ -1,32 +1,109 @@
-#ifndef ANTIVIRUSSCANNER_H
-#define ANTIVIRUSSCANNER_H
-
-#include <QThread>
-#include <QStringList>
-#include <QMap>
-#include <clamav.h>
-
-class AntivirusScanner : public QThread
-{
-    Q_OBJECT
-
-public:
-    AntivirusScanner(const QStringList& filesToScan,
-                     struct cl_engine *engine,
-                     QObject *parent = nullptr);
-
-    void run() override;
-
-signals:
-    void scanProgress(int current, int total);
-    void threatFound(QString filePath, QString threatName);
-    void scanComplete();
-
-private:
-    QStringList files;
-    struct cl_engine *clamEngine;
-
-    bool scanFileWithClamAV(const QString& filePath, QString& detectedThreat);
-};
-
-#endif // ANTIVIRUSSCANNER_H
+#ifndef ANTIVIRUSSCANNER_H
+#define ANTIVIRUSSCANNER_H
+
+#include <QStringList>
+#include <QAtomicInt>
+#include <QMutex>
+#include "verdictcache.h"
+#include "contentdedup.h"
+#include "directorywalker.h"
+#include "engineservice.h"
+#include "blockingqueue.h"
+#include "resultring.h"
+#include "scanjob.h"
+
+class ScanQueue;
+class BufferPool;
+
+// Scan pipeline: a walker thread lists files, I/O reader threads load them
+// into pooled buffers, and CPU workers scan those buffers in memory against
+// one shared engine. Files too large for a buffer are scanned from disk.
+class AntivirusScanner : public ScanJob
+{
+    Q_OBJECT
+
+public:
+    // pathsToScan may mix files and directories; directories are walked
+    // on a separate thread while the workers are already scanning. Each
+    // file is scanned with whatever engine the service holds at that
+    // moment, so signatures reloaded mid-scan apply to the files after.
+    AntivirusScanner(const QStringList& pathsToScan,
+                     EngineService *engines,
+                     QObject *parent = nullptr);
+
+    Progress progress() const override;
+
+    // Workers queue detections in a lock-free ring instead of posting an
+    // event per hit; once the ring fills up they wait for takeResults().
+    int takeResults(QVector<Result>& out, int max = 4096) override;
+
+    // Number of CPU worker threads sharing the engine (defaults to the core count)
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    // Number of I/O threads prefetching file contents, tuned separately
+    // from the CPU workers to set the disk queue depth
+    void setReaderThreadCount(int count);
+    int readerThreadCount() const;
+
+    // Files up to this size are read into memory by the reader threads
+    void setReadBufferSize(qint64 bytes);
+
+    // Per-worker read window for the built-in signature engine
+    void setChunkSize(qint64 bytes);
+
+    // How directories are listed (native getdents64 walker by default)
+    void setWalkerMethod(DirectoryWalker::Method method);
+    // Threads listing directories in parallel (native walker only)
+    void setWalkerThreadCount(int count);
+
+    void run() override;
+
+private:
+    // A file handed from a reader thread to a CPU worker. buffer is null
+    // when the file did not fit and has to be scanned from disk.
+    struct LoadedFile
+    {
+        QString path;
+        FileIdentity id;
+        QByteArray *buffer = nullptr;
+        qint64 length = 0;
+    };
+
+    QStringList paths;
+    EngineService *engines;
+    int workerCount;
+    int readerCount;
+    qint64 readBufferSize;
+    qint64 chunkSize;
+    DirectoryWalker::Method walkerMethod;
+    int walkerThreads;
+    VerdictCache verdictCache;
+    ContentDeduplicator dedup;
+
+    QAtomicInteger<qint64> filesDone;
+    QAtomicInteger<qint64> bytesDone;
+    QAtomicInt errorCount;
+
+    // Guards the queue pointer against progress() racing the end of run()
+    mutable QMutex pendingMutex;
+    ScanQueue *pending;
+
+    // The current path is only copied out when progress() has asked for
+    // it, so workers take pathMutex a few times a second at most
+    mutable QAtomicInt pathWanted;
+    mutable QMutex pathMutex;
+    QString currentPath;
+
+    ResultRing<Result> results;
+
+    void readWorker(ScanQueue *queue, int readerId, BlockingQueue<LoadedFile> *loaded, BufferPool *buffers);
+    bool loadFile(const QString& filePath, QByteArray *buffer, qint64& length);
+    void scanWorker(BlockingQueue<LoadedFile> *loaded, BufferPool *buffers,
+                    QSharedPointer<ScanEngine> engine, int generation);
+    void scanFile(const LoadedFile& file, const ScanEngine& engine);
+    void fileDone(const QString& filePath, qint64 size);
+    void reportThreat(const QString& filePath, const QString& threatName, qint64 size);
+};
+
+#endif // ANTIVIRUSSCANNER_H
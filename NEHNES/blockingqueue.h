@@ -0,0 +1,87 @@
+#ifndef BLOCKINGQUEUE_H
+#define BLOCKINGQUEUE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <algorithm>
+#include <functional>
+
+// Small bounded hand-off queue between pipeline stages. First in, first
+// out, unless it is given an order: then pop() always hands out the item
+// that comes first by before(), and equal items keep their arrival order.
+template <typename T>
+class BlockingQueue
+{
+public:
+    explicit BlockingQueue(int capacity, std::function<bool(const T&, const T&)> before = nullptr)
+        : capacity(capacity)
+        , before(std::move(before))
+        , closed(false)
+        , aborted(false)
+    {
+    }
+
+    bool push(T item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.size() >= capacity && !aborted) {
+            notFull.wait(&mutex);
+        }
+        if (aborted) {
+            return false;
+        }
+
+        if (before) {
+            // The queue holds a handful of items, so a sorted insert is cheap
+            items.insert(std::upper_bound(items.begin(), items.end(), item, before), std::move(item));
+        } else {
+            items.enqueue(std::move(item));
+        }
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        QMutexLocker locker(&mutex);
+        while (items.isEmpty() && !closed && !aborted) {
+            notEmpty.wait(&mutex);
+        }
+        if (aborted || items.isEmpty()) {
+            return false;
+        }
+
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    // No more pushes; pop() drains what is left
+    void close()
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+    }
+
+    void abort()
+    {
+        QMutexLocker locker(&mutex);
+        aborted = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QQueue<T> items;
+    int capacity;
+    std::function<bool(const T&, const T&)> before;
+    bool closed;
+    bool aborted;
+};
+
+#endif // BLOCKINGQUEUE_H
@@ -0,0 +1,57 @@
+#include "bufferpool.h"
+
+BufferPool::BufferPool(int count, qint64 bufferSize)
+    : size(bufferSize)
+    , aborted(false)
+{
+    for (int i = 0; i < qMax(1, count); ++i) {
+        allBuffers.append(new QByteArray());
+    }
+    freeBuffers = allBuffers;
+}
+
+BufferPool::~BufferPool()
+{
+    qDeleteAll(allBuffers);
+}
+
+QByteArray *BufferPool::acquire()
+{
+    QMutexLocker locker(&mutex);
+    while (freeBuffers.isEmpty() && !aborted) {
+        available.wait(&mutex);
+    }
+    if (aborted) {
+        return nullptr;
+    }
+
+    // Buffers are allocated on first use and then kept for the whole scan
+    QByteArray *buffer = freeBuffers.takeLast();
+    if (buffer->size() < size) {
+        buffer->resize(size);
+    }
+    return buffer;
+}
+
+void BufferPool::release(QByteArray *buffer)
+{
+    if (!buffer) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    freeBuffers.append(buffer);
+    available.wakeOne();
+}
+
+void BufferPool::abort()
+{
+    QMutexLocker locker(&mutex);
+    aborted = true;
+    available.wakeAll();
+}
+
+qint64 BufferPool::bufferSize() const
+{
+    return size;
+}
@@ -0,0 +1,33 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+// Fixed set of reusable read buffers shared by the I/O reader threads.
+// Readers block in acquire() once every buffer is in flight, which caps
+// the memory held by prefetched file contents.
+class BufferPool
+{
+public:
+    BufferPool(int count, qint64 bufferSize);
+    ~BufferPool();
+
+    QByteArray *acquire();
+    void release(QByteArray *buffer);
+    void abort();
+
+    qint64 bufferSize() const;
+
+private:
+    QMutex mutex;
+    QWaitCondition available;
+    QVector<QByteArray*> freeBuffers;
+    QVector<QByteArray*> allBuffers;
+    qint64 size;
+    bool aborted;
+};
+
+#endif // BUFFERPOOL_H
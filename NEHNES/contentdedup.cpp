@@ -0,0 +1,201 @@
+#include "contentdedup.h"
+#include "scanfilehandle.h"
+#include <QCryptographicHash>
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+ContentDeduplicator::ContentDeduplicator()
+    : sizes(MaxEntries)
+{
+}
+
+bool ContentDeduplicator::lookup(const QString& path, const FileIdentity& id,
+                                 QByteArray& fingerprint, Verdict& verdict,
+                                 const QByteArray *contents, int fd)
+{
+    fingerprint.clear();
+    if (!id.valid || id.size <= 0) {
+        return false;
+    }
+
+    QString firstPath;
+    Verdict firstVerdict;
+    {
+        QMutexLocker locker(&mutex);
+        SizeBucket *bucket = sizes.object(id.size);
+        if (!bucket) {
+            // A size nobody else has cannot be a duplicate (yet)
+            bucket = new SizeBucket;
+            bucket->firstPath = path;
+            bucket->firstId = id;
+            sizes.insert(id.size, bucket);
+            return false;
+        }
+
+        if (bucket->firstDone && !bucket->firstHashed) {
+            bucket->firstHashed = true;
+            // Only trust the earlier verdict if that file is still unchanged
+            FileIdentity now = FileIdentity::of(bucket->firstPath);
+            if (now.valid && now.modified == bucket->firstId.modified
+                && now.changed == bucket->firstId.changed) {
+                firstPath = bucket->firstPath;
+                firstVerdict = bucket->firstVerdict;
+            }
+        }
+    }
+
+    if (!firstPath.isEmpty()) {
+        QByteArray firstFingerprint = fingerprintFile(firstPath, id.size);
+        if (!firstFingerprint.isEmpty()) {
+            QMutexLocker locker(&mutex);
+            remember(id.size, firstFingerprint, firstVerdict);
+        }
+    }
+
+    if (contents) {
+        fingerprint = fingerprintData(*contents, id.size);
+    } else if (fd >= 0) {
+        fingerprint = fingerprintDescriptor(fd, id.size);
+    } else {
+        fingerprint = fingerprintFile(path, id.size);
+    }
+    if (fingerprint.isEmpty()) {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    const SizeBucket *bucket = sizes.object(id.size);
+    if (!bucket) {
+        return false;
+    }
+    auto blob = bucket->blobs.constFind(fingerprint);
+    if (blob == bucket->blobs.constEnd()) {
+        return false;
+    }
+
+    verdict = *blob;
+    duplicateCount.fetchAndAddRelaxed(1);
+    return true;
+}
+
+void ContentDeduplicator::record(const QString& path, const FileIdentity& id,
+                                 const QByteArray& fingerprint, const Verdict& verdict)
+{
+    QMutexLocker locker(&mutex);
+
+    if (!fingerprint.isEmpty()) {
+        remember(id.size, fingerprint, verdict);
+        return;
+    }
+
+    SizeBucket *bucket = sizes.object(id.size);
+    if (bucket && bucket->firstPath == path) {
+        bucket->firstVerdict = verdict;
+        bucket->firstDone = true;
+    }
+}
+
+void ContentDeduplicator::remember(qint64 size, const QByteArray& fingerprint, const Verdict& verdict)
+{
+    // Taken out and put back so the cache sees the bucket's new cost; this
+    // may evict the least recently used sizes
+    SizeBucket *bucket = sizes.take(size);
+    if (!bucket) {
+        // Forgotten since; the next file of this size starts over
+        return;
+    }
+    bucket->blobs.insert(fingerprint, verdict);
+    sizes.insert(size, bucket, 1 + int(bucket->blobs.size()));
+}
+
+int ContentDeduplicator::duplicates() const
+{
+    return duplicateCount.loadRelaxed();
+}
+
+namespace {
+
+QCryptographicHash::Algorithm fingerprintAlgorithm()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return QCryptographicHash::Blake2b_256;
+#else
+    return QCryptographicHash::Sha256;
+#endif
+}
+
+}
+
+QByteArray ContentDeduplicator::fingerprintData(const QByteArray& contents, qint64 size)
+{
+    if (contents.size() != size) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(fingerprintAlgorithm());
+    hash.addData(QByteArray::number(size));
+    hash.addData(contents);
+    return hash.result();
+}
+
+QByteArray ContentDeduplicator::fingerprintFile(const QString& path, qint64 size)
+{
+    // The earlier file of a size bucket, read a second time now that it has
+    // company: with O_NOATIME, and without keeping its pages afterwards
+    ScanFileHandle handle(path);
+    if (handle.open()) {
+        return fingerprintDescriptor(handle.descriptor(), size);
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(fingerprintAlgorithm());
+    hash.addData(QByteArray::number(size));
+    if (!hash.addData(&file) || file.size() != size) {
+        return QByteArray();
+    }
+
+    return hash.result();
+}
+
+QByteArray ContentDeduplicator::fingerprintDescriptor(int fd, qint64 size)
+{
+#ifdef Q_OS_UNIX
+    QCryptographicHash hash(fingerprintAlgorithm());
+    hash.addData(QByteArray::number(size));
+
+    // pread() leaves the file offset alone for whoever scans through fd next
+    QByteArray chunk(1024 * 1024, Qt::Uninitialized);
+    qint64 offset = 0;
+    for (;;) {
+        ssize_t got = ::pread(fd, chunk.data(), size_t(chunk.size()), off_t(offset));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return QByteArray();
+        }
+        if (got == 0) {
+            break;
+        }
+        hash.addData(QByteArray::fromRawData(chunk.constData(), qsizetype(got)));
+        offset += got;
+    }
+    if (offset != size) {
+        return QByteArray();
+    }
+
+    return hash.result();
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(size);
+    return QByteArray();
+#endif
+}
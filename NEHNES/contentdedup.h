@@ -0,0 +1,76 @@
+#ifndef CONTENTDEDUP_H
+#define CONTENTDEDUP_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QString>
+#include "verdictcache.h"
+
+// In-run deduplication of identical file contents.
+//
+// Only files whose size has already been seen in this run are fingerprinted,
+// so the hash cost is paid for likely duplicates and nothing else. The first
+// file of each size is hashed lazily, once a second file of that size turns
+// up and the first one's verdict is known.
+//
+// Everything is kept per size, and only for the MaxEntries most recently
+// seen sizes and fingerprints together (some 20-30 MB at most); the least
+// recently used sizes are forgotten first. A forgotten size only costs a
+// missed duplicate: the next file of that size starts the bucket over.
+class ContentDeduplicator
+{
+public:
+    ContentDeduplicator();
+
+    struct Verdict
+    {
+        bool infected = false;
+        QString threatName;
+    };
+
+    // Returns true when an identical blob has already been scanned. Otherwise
+    // fingerprint is set (possibly empty) and must be handed back to record()
+    // after the file has been scanned. If the caller already holds the file
+    // contents, they are hashed in place instead of reading the file again;
+    // if it holds an open descriptor (fd), the file is hashed through that.
+    // Files are only ever read through ScanFileHandle, so hashing neither
+    // touches atime nor leaves pages behind in the cache.
+    bool lookup(const QString& path, const FileIdentity& id,
+                QByteArray& fingerprint, Verdict& verdict,
+                const QByteArray *contents = nullptr, int fd = -1);
+    void record(const QString& path, const FileIdentity& id,
+                const QByteArray& fingerprint, const Verdict& verdict);
+
+    int duplicates() const;
+
+private:
+    // Size buckets and fingerprints kept at once
+    static const int MaxEntries = 100000;
+
+    struct SizeBucket
+    {
+        QString firstPath;
+        FileIdentity firstId;
+        Verdict firstVerdict;
+        bool firstDone = false;
+        bool firstHashed = false;
+        // Verdicts of the contents of this size hashed so far
+        QHash<QByteArray, Verdict> blobs;
+    };
+
+    QMutex mutex;
+    // Costs one entry per bucket plus one per fingerprint in it
+    QCache<qint64, SizeBucket> sizes;
+    QAtomicInt duplicateCount;
+
+    void remember(qint64 size, const QByteArray& fingerprint, const Verdict& verdict);
+
+    static QByteArray fingerprintFile(const QString& path, qint64 size);
+    static QByteArray fingerprintDescriptor(int fd, qint64 size);
+    static QByteArray fingerprintData(const QByteArray& contents, qint64 size);
+};
+
+#endif // CONTENTDEDUP_H
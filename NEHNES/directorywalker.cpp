@@ -0,0 +1,283 @@
+#include "directorywalker.h"
+#include "direntiterator.h"
+#include <QAtomicInt>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace {
+const int BatchSize = 64;
+
+// Directories waiting to be listed by one thread of the parallel walk
+struct DirectoryDeque
+{
+    QMutex mutex;
+    std::deque<DirentIterator::Directory> items;
+};
+}
+
+DirectoryWalker::DirectoryWalker(const QStringList& roots, ScanQueue *queue)
+    : rootPaths(roots)
+    , queue(queue)
+    , method(defaultMethod())
+    , threadCount(1)
+    , errorCount(0)
+{
+    batch.reserve(BatchSize);
+}
+
+DirectoryWalker::Method DirectoryWalker::defaultMethod()
+{
+    return DirentIterator::isSupported() ? Native : Portable;
+}
+
+void DirectoryWalker::setMethod(Method method)
+{
+    this->method = DirentIterator::isSupported() ? method : Portable;
+}
+
+int DirectoryWalker::defaultThreadCount()
+{
+    // Enough requests in flight for an SSD or a network mount without
+    // crowding out the scan workers
+    return qBound(1, QThread::idealThreadCount() / 2, 8);
+}
+
+void DirectoryWalker::setThreadCount(int count)
+{
+    threadCount = qMax(1, count);
+}
+
+int DirectoryWalker::errors() const
+{
+    return errorCount;
+}
+
+void DirectoryWalker::walk()
+{
+    bool parallel = threadCount > 1 && method == Native;
+    QStringList directories;
+
+    for (const QString& root : rootPaths) {
+        QFileInfo info(root);
+        bool keepGoing = true;
+        if (!info.isDir()) {
+            keepGoing = add(info.absoluteFilePath(), info.size());
+        } else if (parallel) {
+            directories.append(info.absoluteFilePath());
+        } else {
+            keepGoing = walkDirectory(info.absoluteFilePath());
+        }
+        if (!keepGoing) {
+            queue->close();
+            return;
+        }
+    }
+
+    if (flush() && !directories.isEmpty()) {
+        walkParallel(directories);
+    }
+    queue->close();
+}
+
+bool DirectoryWalker::add(const QString& path, qint64 size)
+{
+    batch.append(ScanItem{path, size});
+    return batch.size() < BatchSize || flush();
+}
+
+bool DirectoryWalker::flush()
+{
+    if (batch.isEmpty()) {
+        return true;
+    }
+
+    bool accepted = queue->push(batch);
+    batch.clear();
+    return accepted;
+}
+
+bool DirectoryWalker::walkDirectory(const QString& path)
+{
+    return method == Native ? walkNative(path) : walkPortable(path);
+}
+
+bool DirectoryWalker::walkNative(const QString& path)
+{
+    DirentIterator it(path);
+
+    while (it.next()) {
+        if (!add(it.filePath(), it.size())) {
+            errorCount += it.errors();
+            return false;
+        }
+    }
+    errorCount += it.errors();
+    return true;
+}
+
+bool DirectoryWalker::walkPortable(const QString& path)
+{
+    // QDirIterator hands out one entry at a time instead of building a list
+    // per directory, and does not follow directory symlinks into loops.
+    // Hidden and system entries are listed and then filtered down to plain
+    // regular files, so both walkers see exactly the same set.
+    QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (info.isSymLink() || !info.isFile()) {
+            continue;
+        }
+        if (!add(it.filePath(), info.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DirectoryWalker::walkParallel(const QStringList& directories)
+{
+    int threads = threadCount;
+    std::vector<std::unique_ptr<DirectoryDeque>> deques;
+    for (int i = 0; i < threads; ++i) {
+        deques.push_back(std::make_unique<DirectoryDeque>());
+    }
+
+    // Walkers waiting for work, and whether the walk is over. Both only
+    // change under idleMutex, and every wakeup is sent holding it, so a
+    // walker that found nothing to take cannot miss a push that follows.
+    QMutex idleMutex;
+    QWaitCondition workAvailable;
+    int idle = 0;
+    bool finished = false;
+    QAtomicInt stopped(0);
+    QAtomicInt failures(0);
+
+    for (int i = 0; i < directories.size(); ++i) {
+        deques[size_t(i % threads)]->items.push_back(DirentIterator::Directory{nullptr, QFile::encodeName(directories.at(i))});
+    }
+
+    // Own deque from the back, so each thread goes depth-first through what
+    // it found itself; steal from the front, where the big subtrees near
+    // the top of the tree are
+    auto take = [&deques, threads](int self, DirentIterator::Directory& item) {
+        for (int n = 0; n < threads; ++n) {
+            int victim = (self + n) % threads;
+            DirectoryDeque& d = *deques[size_t(victim)];
+            QMutexLocker locker(&d.mutex);
+            if (d.items.empty()) {
+                continue;
+            }
+            if (victim == self) {
+                item = std::move(d.items.back());
+                d.items.pop_back();
+            } else {
+                item = std::move(d.items.front());
+                d.items.pop_front();
+            }
+            return true;
+        }
+        return false;
+    };
+
+    auto anyQueued = [&deques] {
+        for (const auto& d : deques) {
+            QMutexLocker locker(&d->mutex);
+            if (!d->items.empty()) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto stop = [&] {
+        stopped.storeRelaxed(1);
+        QMutexLocker locker(&idleMutex);
+        workAvailable.wakeAll();
+    };
+
+    auto walker = [&, this](int self) {
+        QVector<ScanItem> files;
+        files.reserve(BatchSize);
+        auto flushFiles = [&files, &stop, this] {
+            if (!files.isEmpty() && !queue->push(files)) {
+                stop();
+            }
+            files.clear();
+        };
+
+        while (!stopped.loadRelaxed()) {
+            DirentIterator::Directory item;
+            if (!take(self, item)) {
+                // Files found so far go out before this thread sits idle
+                flushFiles();
+
+                QMutexLocker locker(&idleMutex);
+                ++idle;
+                while (!finished && !stopped.loadRelaxed() && !anyQueued()) {
+                    if (idle == threads) {
+                        // Nobody is listing a directory, so no more can turn up
+                        finished = true;
+                        workAvailable.wakeAll();
+                        break;
+                    }
+                    workAvailable.wait(&idleMutex);
+                }
+                --idle;
+                if (finished) {
+                    break;
+                }
+                continue;
+            }
+
+            DirentIterator it(std::move(item));
+            it.setSubdirectoryHandler([&](DirentIterator::Directory&& subdirectory) {
+                {
+                    DirectoryDeque& own = *deques[size_t(self)];
+                    QMutexLocker locker(&own.mutex);
+                    own.items.push_back(std::move(subdirectory));
+                }
+                QMutexLocker locker(&idleMutex);
+                if (idle > 0) {
+                    workAvailable.wakeOne();
+                }
+            });
+
+            while (!stopped.loadRelaxed() && it.next()) {
+                files.append(ScanItem{it.filePath(), it.size()});
+                if (files.size() >= BatchSize) {
+                    flushFiles();
+                }
+            }
+            failures.fetchAndAddRelaxed(it.errors());
+        }
+
+        if (!stopped.loadRelaxed()) {
+            flushFiles();
+        }
+    };
+
+    QList<QThread*> workers;
+    for (int i = 1; i < threads; ++i) {
+        QThread *thread = QThread::create(walker, i);
+        workers.append(thread);
+        thread->start();
+    }
+    walker(0);
+    for (QThread *thread : workers) {
+        thread->wait();
+        delete thread;
+    }
+
+    errorCount += failures.loadRelaxed();
+    return !stopped.loadRelaxed();
+}
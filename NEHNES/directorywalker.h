@@ -0,0 +1,56 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QStringList>
+#include <QVector>
+#include "scanqueue.h"
+
+// Streams every regular file below the given roots into a ScanQueue.
+// Plain file paths in the root list are passed through unchanged.
+// Files are handed over in small batches together with their size, so
+// the queue can schedule the largest ones first.
+//
+// With more than one thread (native method only) directories become work
+// items: each walker thread lists directories from its own deque and
+// steals from the others when it runs dry, so several getdents() calls are
+// in flight at once instead of each waiting for the one before.
+class DirectoryWalker
+{
+public:
+    enum Method {
+        Native,  // getdents64() with d_type (Linux), see DirentIterator
+        Portable // QDirIterator
+    };
+
+    DirectoryWalker(const QStringList& roots, ScanQueue *queue);
+
+    // Native where the platform has it
+    static Method defaultMethod();
+    void setMethod(Method method);
+
+    // Number of threads listing directories in parallel
+    static int defaultThreadCount();
+    void setThreadCount(int count);
+
+    void walk();
+
+    // Directories that could not be listed (native walker only)
+    int errors() const;
+
+private:
+    QStringList rootPaths;
+    ScanQueue *queue;
+    QVector<ScanItem> batch;
+    Method method;
+    int threadCount;
+    int errorCount;
+
+    bool add(const QString& path, qint64 size);
+    bool flush();
+    bool walkDirectory(const QString& path);
+    bool walkNative(const QString& path);
+    bool walkPortable(const QString& path);
+    bool walkParallel(const QStringList& directories);
+};
+
+#endif // DIRECTORYWALKER_H
@@ -0,0 +1,201 @@
+#include "direntiterator.h"
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Bigger than readdir()'s buffer: fewer syscalls on wide directories
+const int BufferSize = 64 * 1024;
+
+#ifdef Q_OS_LINUX
+// Kernel layout of a getdents64() record
+struct LinuxDirent64
+{
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+QByteArray joinPath(const QByteArray& directory, const char *name)
+{
+    QByteArray path = directory;
+    if (!path.endsWith('/')) {
+        path += '/';
+    }
+    return path + name;
+}
+#endif
+
+}
+
+DirentIterator::Descriptor::Descriptor(int fd)
+    : fd(fd)
+{
+}
+
+DirentIterator::Descriptor::~Descriptor()
+{
+#ifdef Q_OS_LINUX
+    ::close(fd);
+#endif
+}
+
+DirentIterator::DirentIterator(const QString& root)
+    : bufferPos(0)
+    , bufferEnd(0)
+    , currentSize(0)
+    , errorCount(0)
+{
+    pending.push_back(Directory{nullptr, QFile::encodeName(root)});
+}
+
+DirentIterator::DirentIterator(Directory directory)
+    : bufferPos(0)
+    , bufferEnd(0)
+    , currentSize(0)
+    , errorCount(0)
+{
+    pending.push_back(std::move(directory));
+}
+
+bool DirentIterator::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DirentIterator::setSubdirectoryHandler(std::function<void(Directory&&)> handler)
+{
+    subdirectoryHandler = std::move(handler);
+}
+
+bool DirentIterator::openNextDirectory()
+{
+#ifdef Q_OS_LINUX
+    while (!pending.empty()) {
+        Directory next = std::move(pending.back());
+        pending.pop_back();
+        directory = std::move(next.path);
+
+        int fd;
+        if (next.parent) {
+            // Relative to the directory it was listed in, and never through
+            // a symlink
+            const char *name = directory.constData() + directory.lastIndexOf('/') + 1;
+            fd = ::openat(next.parent->fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        } else {
+            // The root may itself be a symlink the user pointed us at
+            fd = ::open(directory.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        if (fd >= 0) {
+            directoryFd = std::make_shared<const Descriptor>(fd);
+            bufferPos = bufferEnd = 0;
+            return true;
+        }
+        ++errorCount;
+    }
+#endif
+    return false;
+}
+
+bool DirentIterator::next()
+{
+#ifdef Q_OS_LINUX
+    if (buffer.isEmpty()) {
+        buffer.resize(BufferSize);
+    }
+
+    for (;;) {
+        if (bufferPos >= bufferEnd) {
+            if (directoryFd) {
+                long count = syscall(SYS_getdents64, directoryFd->fd, buffer.data(), buffer.size());
+                if (count > 0) {
+                    bufferPos = 0;
+                    bufferEnd = int(count);
+                    continue;
+                }
+                if (count < 0) {
+                    ++errorCount;
+                }
+                // Closes it, unless subdirectories still wait to be opened from it
+                directoryFd.reset();
+            }
+            if (!openNextDirectory()) {
+                return false;
+            }
+            continue;
+        }
+
+        const LinuxDirent64 *entry = reinterpret_cast<const LinuxDirent64*>(buffer.constData() + bufferPos);
+        bufferPos += entry->d_reclen;
+
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        // Some filesystems leave d_type unset; only then is a stat needed
+        // to tell what the entry is
+        unsigned char type = entry->d_type;
+        struct stat info;
+        bool haveInfo = false;
+        if (type == DT_UNKNOWN) {
+            if (fstatat(directoryFd->fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+                continue;
+            }
+            haveInfo = true;
+            type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (type == DT_DIR) {
+            Directory subdirectory{directoryFd, joinPath(directory, name)};
+            if (subdirectoryHandler) {
+                subdirectoryHandler(std::move(subdirectory));
+            } else {
+                pending.push_back(std::move(subdirectory));
+            }
+            continue;
+        }
+        if (type != DT_REG) {
+            // Symlinks, devices, sockets and pipes
+            continue;
+        }
+
+        if (!haveInfo && fstatat(directoryFd->fd, name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        currentPath = joinPath(directory, name);
+        currentSize = qint64(info.st_size);
+        return true;
+    }
+#else
+    return false;
+#endif
+}
+
+QString DirentIterator::filePath() const
+{
+    return QFile::decodeName(currentPath);
+}
+
+qint64 DirentIterator::size() const
+{
+    return currentSize;
+}
+
+int DirentIterator::errors() const
+{
+    return errorCount;
+}
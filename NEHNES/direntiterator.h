@@ -0,0 +1,86 @@
+#ifndef DIRENTITERATOR_H
+#define DIRENTITERATOR_H
+
+#include <QByteArray>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Lists the regular files below a directory straight from getdents64(),
+// one at a time. The entry type comes from d_type, so directories and
+// everything else are never stat'ed; a regular file costs one fstatat()
+// relative to its open directory, for the size the scheduler wants.
+// Subdirectories wait on an explicit stack, so depth costs no stack.
+// Each one is opened with openat() relative to its parent, which stays
+// open until its last subdirectory has been, so the kernel never walks
+// a full path again and a rename higher up cannot send us elsewhere.
+// That keeps about one descriptor open per level of the tree, as
+// readdir()-based walkers do. Symlinks below the root are not followed,
+// which also rules out loops.
+//
+// Hidden files are listed like any other; symlinks, devices, sockets and
+// pipes are skipped.
+//
+// Linux only; elsewhere isSupported() is false and next() finds nothing.
+class DirentIterator
+{
+public:
+    // An open directory, closed with the last reference
+    class Descriptor
+    {
+    public:
+        explicit Descriptor(int fd);
+        ~Descriptor();
+        const int fd;
+
+    private:
+        Q_DISABLE_COPY(Descriptor)
+    };
+
+    // A directory waiting to be listed: its path (in the local 8-bit
+    // encoding) and the open parent it is opened relative to. Roots have
+    // no parent, are opened by path and may themselves be symlinks.
+    struct Directory
+    {
+        std::shared_ptr<const Descriptor> parent;
+        QByteArray path;
+    };
+
+    explicit DirentIterator(const QString& root);
+    explicit DirentIterator(Directory directory);
+
+    static bool isSupported();
+
+    // Hands subdirectories to handler instead of descending into them, so
+    // only the starting directory is listed. Lets several threads share
+    // one tree.
+    void setSubdirectoryHandler(std::function<void(Directory&&)> handler);
+
+    // Advances to the next regular file; false when the tree is done
+    bool next();
+
+    QString filePath() const;
+    qint64 size() const;
+
+    // Directories that could not be opened or read
+    int errors() const;
+
+private:
+    Q_DISABLE_COPY(DirentIterator)
+
+    std::vector<Directory> pending;
+    std::function<void(Directory&&)> subdirectoryHandler;
+    QByteArray directory;
+    std::shared_ptr<const Descriptor> directoryFd;
+    QByteArray buffer;
+    int bufferPos;
+    int bufferEnd;
+    QByteArray currentPath;
+    qint64 currentSize;
+    int errorCount;
+
+    bool openNextDirectory();
+};
+
+#endif // DIRENTITERATOR_H
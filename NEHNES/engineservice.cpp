@@ -0,0 +1,507 @@
+#include "engineservice.h"
+#include "memorypressure.h"
+#include "signatureupdater.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QLocale>
+#include <QThread>
+#include <QTimer>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+EngineService::EngineService(QObject *parent)
+    : QObject(parent)
+    , currentState(NotLoaded)
+    , engineProfile(ScanEngine::Full)
+    , loader(nullptr)
+    , reloadPending(false)
+    , clamInitialized(false)
+    , watcher(new QFileSystemWatcher(this))
+    , reloadTimer(new QTimer(this))
+    , activeScans(0)
+    , idleTimeoutMinutes(30)
+    , idleTimer(new QTimer(this))
+    , evictions(0)
+    , wakeReloads(0)
+    , wakeReloadMs(0)
+    , waking(false)
+{
+    // freshclam replaces several files in a row; reload once it is done
+    reloadTimer->setSingleShot(true);
+    reloadTimer->setInterval(2000);
+    connect(reloadTimer, &QTimer::timeout, this, &EngineService::databasesChanged);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, reloadTimer, qOverload<>(&QTimer::start));
+
+    idleClock.start();
+    idleTimer->setInterval(30 * 1000);
+    connect(idleTimer, &QTimer::timeout, this, &EngineService::checkIdle);
+    idleTimer->start();
+}
+
+EngineService::~EngineService()
+{
+    // libclamav cannot abandon a load halfway, so let it finish
+    if (loader) {
+        loader->wait();
+        delete loader;
+    }
+}
+
+void EngineService::startLoading()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (currentState != NotLoaded) {
+            return;
+        }
+        currentState = Loading;
+    }
+    emit stateChanged(Loading);
+
+    startLoader();
+}
+
+void EngineService::reload()
+{
+    State now = state();
+    if (now == NotLoaded) {
+        startLoading();
+        return;
+    }
+    // Nothing to refresh; the next scan loads the current databases anyway
+    if (now == Evicted) {
+        return;
+    }
+
+    // One load at a time; a change that arrives meanwhile gets its own pass
+    if (loader) {
+        reloadPending = true;
+        return;
+    }
+    startLoader();
+}
+
+void EngineService::databasesChanged()
+{
+    QString stamp = databaseStamp(findDatabase());
+    {
+        QMutexLocker locker(&mutex);
+        if (stamp == loadedStamp) {
+            return;
+        }
+    }
+    reload();
+}
+
+bool EngineService::updateSignatures(const QString& mirror)
+{
+    if (loader || state() == NotLoaded) {
+        return false;
+    }
+
+    QString directory = updateDirectory();
+    loader = QThread::create([this, mirror, directory] {
+        SignatureUpdater::Report report = SignatureUpdater(mirror, directory).run();
+
+        QStringList lines;
+        if (report.ok && report.fullDatabasesOnly) {
+            lines << QString("⚠ Built without libfreshclam: only full databases are copied from "
+                             "the mirror, .cdiff patches are not applied");
+        }
+        if (!report.ok) {
+            lines << QString("⚠ Signature update failed: %1").arg(report.error);
+        } else if (report.updated.isEmpty()) {
+            lines << QString("✓ Signatures are up to date (checked %1 in %2 ms)")
+                         .arg(mirror).arg(report.applyMs);
+        } else {
+            QString transfer = report.transferBytes < 0
+                                   ? QString("transfer size not reported by the mirror")
+                                   : QLocale().formattedDataSize(report.transferBytes) + " transferred";
+            lines << QString("✓ Signatures updated from %1: %2").arg(mirror, report.updated.join(", "))
+                  << QString("✓ %1, applied in %2 ms").arg(transfer).arg(report.applyMs);
+            // The engine ready line that follows is the reload time
+            load(lines);
+            return;
+        }
+
+        {
+            QMutexLocker locker(&mutex);
+            log = lines;
+        }
+        emit stateChanged(state());
+        QMetaObject::invokeMethod(this, &EngineService::loadFinished, Qt::QueuedConnection);
+    });
+    loader->start();
+    return true;
+}
+
+void EngineService::setProfile(ScanEngine::Profile profile)
+{
+    State loaded;
+    {
+        QMutexLocker locker(&mutex);
+        if (engineProfile == profile) {
+            return;
+        }
+        engineProfile = profile;
+        loaded = currentState;
+    }
+
+    if (loaded != NotLoaded && loaded != Evicted) {
+        reload();
+    }
+}
+
+ScanEngine::Profile EngineService::profile() const
+{
+    QMutexLocker locker(&mutex);
+    return engineProfile;
+}
+
+QSharedPointer<ScanEngine> EngineService::waitForEngine(int *generation, int timeoutMs)
+{
+    QMutexLocker locker(&mutex);
+    if (!current && currentState == Evicted) {
+        // Loader threads are started from the service's own thread
+        QMetaObject::invokeMethod(this, &EngineService::wake, Qt::QueuedConnection);
+    }
+    if (!current) {
+        engineAvailable.wait(&mutex, timeoutMs);
+    }
+
+    if (generation) {
+        *generation = engineGeneration.loadRelaxed();
+    }
+    return current;
+}
+
+void EngineService::beginScan()
+{
+    QMutexLocker locker(&mutex);
+    ++activeScans;
+}
+
+void EngineService::endScan()
+{
+    QMutexLocker locker(&mutex);
+    --activeScans;
+    idleClock.restart();
+}
+
+void EngineService::setIdleTimeout(int minutes)
+{
+    QMutexLocker locker(&mutex);
+    idleTimeoutMinutes = qMax(0, minutes);
+}
+
+void EngineService::checkIdle()
+{
+    MemoryPressure pressure = MemoryPressure::sample();
+    QSharedPointer<ScanEngine> evicted;
+    qint64 idleMs = 0;
+
+    {
+        QMutexLocker locker(&mutex);
+        if (loader || activeScans > 0 || idleTimeoutMinutes == 0
+            || !current || !current->clamEngine()) {
+            return;
+        }
+
+        // Under memory pressure a minute of idleness is enough
+        qint64 limit = qint64(idleTimeoutMinutes) * 60 * 1000;
+        if (pressure.isHigh()) {
+            limit = qMin<qint64>(limit, 60 * 1000);
+        }
+        idleMs = idleClock.elapsed();
+        if (idleMs < limit) {
+            return;
+        }
+
+        evicted.swap(current);
+        engineGeneration.fetchAndAddRelease(1);
+        currentState = Evicted;
+        ++evictions;
+        log = QStringList{QString("Engine unloaded after %1 min idle to free memory (memory: %2); "
+                                  "it reloads on the next scan")
+                              .arg(idleMs / 60000).arg(pressure.describe())};
+    }
+
+    // Last reference: this frees the compiled engine. Then ask the C
+    // allocator to hand the freed pages back to the OS.
+    evicted.reset();
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+
+    emit stateChanged(Evicted);
+}
+
+void EngineService::wake()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (currentState != Evicted || loader) {
+            return;
+        }
+        currentState = Loading;
+        waking = true;
+    }
+    emit stateChanged(Loading);
+    startLoader();
+}
+
+QString EngineService::updateDirectory() const
+{
+    QSharedPointer<ScanEngine> engine = this->engine();
+    if (engine && !engine->databasePath().isEmpty()) {
+        return engine->databasePath();
+    }
+    QString existing = findDatabase();
+    return existing.isEmpty() ? QDir::homePath() + "/.clamav" : existing;
+}
+
+void EngineService::startLoader()
+{
+    loader = QThread::create([this] { load(); });
+    loader->start();
+}
+
+void EngineService::loadFinished()
+{
+    if (loader) {
+        loader->wait();
+        delete loader;
+        loader = nullptr;
+    }
+
+    watchDatabases();
+
+    if (reloadPending) {
+        reloadPending = false;
+        startLoader();
+    }
+}
+
+void EngineService::watchDatabases()
+{
+    // Watch every location, so a database installed after startup is
+    // picked up as well as updates to the one in use
+    QStringList locations;
+    for (const QString& path : databaseLocations()) {
+        if (QDir(path).exists()) {
+            locations.append(path);
+        }
+    }
+
+    QStringList watched = watcher->directories();
+    for (const QString& path : locations) {
+        if (!watched.contains(path)) {
+            watcher->addPath(path);
+        }
+    }
+}
+
+EngineService::State EngineService::state() const
+{
+    QMutexLocker locker(&mutex);
+    return currentState;
+}
+
+QSharedPointer<ScanEngine> EngineService::engine(int *generation) const
+{
+    QMutexLocker locker(&mutex);
+    if (generation) {
+        *generation = engineGeneration.loadRelaxed();
+    }
+    return current;
+}
+
+int EngineService::generation() const
+{
+    return engineGeneration.loadAcquire();
+}
+
+QStringList EngineService::loadLog() const
+{
+    QMutexLocker locker(&mutex);
+    return log;
+}
+
+QString EngineService::takeWarning()
+{
+    QMutexLocker locker(&mutex);
+    QString warning = warningText;
+    warningText.clear();
+    return warning;
+}
+
+QStringList EngineService::databaseLocations()
+{
+    // Try common database locations
+    return {
+        "/var/lib/clamav",              // Debian, Ubuntu, Fedora, Arch
+        "/usr/local/share/clamav",      // built from source, FreeBSD
+        "/usr/share/clamav",
+        "/opt/homebrew/var/lib/clamav", // Homebrew on Apple silicon
+        "/usr/local/var/lib/clamav",    // Homebrew on Intel
+        "C:/Program Files/ClamAV/database",
+        "C:/ProgramData/ClamAV",
+        "C:/Program Files/ClamAV",
+        QDir::homePath() + "/.clamav" // User directory
+    };
+}
+
+QString EngineService::databaseStamp(const QString& directory)
+{
+    if (directory.isEmpty()) {
+        return QString();
+    }
+
+    QStringList parts;
+    const QFileInfoList files = QDir(directory).entryInfoList(QDir::Files, QDir::Name);
+    for (const QFileInfo& file : files) {
+        parts << QString("%1:%2:%3").arg(file.fileName()).arg(file.size())
+                     .arg(file.lastModified().toMSecsSinceEpoch());
+    }
+    return directory + "|" + parts.join('|');
+}
+
+QString EngineService::findDatabase()
+{
+    // An empty directory (freshclam never ran) is no better than none
+    const QStringList databaseFiles = {"*.cvd", "*.cld", "*.cud", "*.hdb", "*.ndb", "*.ldb"};
+    for (const QString& path : databaseLocations()) {
+        if (!QDir(path).entryList(databaseFiles, QDir::Files).isEmpty()) {
+            return path;
+        }
+    }
+    return QString();
+}
+
+void EngineService::load(const QStringList& preface)
+{
+    QStringList lines = preface;
+    QString warning;
+    QSharedPointer<ScanEngine> engine;
+    QSharedPointer<ScanEngine> previous = this->engine();
+    ScanEngine::Profile profile = this->profile();
+    QElapsedTimer total;
+    total.start();
+
+    // cl_init() is process-wide; loads never overlap, so this runs once
+    QElapsedTimer timer;
+    timer.start();
+    cl_error_t ret = CL_SUCCESS;
+    if (!clamInitialized) {
+        ret = cl_init(CL_INIT_DEFAULT);
+        clamInitialized = (ret == CL_SUCCESS);
+    }
+    qint64 initMs = timer.elapsed();
+
+    QString dbPath;
+    QString stamp;
+    if (ret != CL_SUCCESS) {
+        warning = QString("Failed to initialize ClamAV: %1").arg(cl_strerror(ret));
+    } else {
+        dbPath = findDatabase();
+        if (dbPath.isEmpty()) {
+            warning = "ClamAV database not found!\n\n"
+                      "Please install ClamAV and update virus definitions:\n"
+                      "Linux: sudo apt-get install clamav\n"
+                      "       sudo freshclam\n"
+                      "macOS: brew install clamav\n"
+                      "       freshclam\n"
+                      "Windows: Download from clamav.net\n\n"
+                      "Falling back to basic signature detection.";
+        }
+    }
+
+    if (!dbPath.isEmpty()) {
+        stamp = databaseStamp(dbPath);
+        QString error;
+        engine = ScanEngine::loadClamAV(dbPath, profile, error);
+        if (!engine) {
+            warning = error + "\n\nFalling back to basic detection.";
+        }
+    }
+
+    State state = Ready;
+    if (engine) {
+        if (previous) {
+            lines << QString("✓ Signatures reloaded: %1 virus signatures from %2")
+                         .arg(engine->signatureCount()).arg(dbPath);
+        } else {
+            lines << QString("✓ ClamAV initialized successfully")
+                  << QString("✓ Loaded %1 virus signatures from %2").arg(engine->signatureCount()).arg(dbPath);
+        }
+        lines << QString("✓ Engine ready in %1 ms (init %2 ms, load %3 ms, compile %4 ms)")
+                     .arg(total.elapsed()).arg(initMs)
+                     .arg(engine->loadTime()).arg(engine->compileTime());
+        QString resident = engine->residentBytes() < 0
+                               ? QString("unknown")
+                               : QLocale().formattedDataSize(engine->residentBytes());
+        lines << QString("✓ Profile \"%1\": %2 resident")
+                     .arg(ScanEngine::profileName(profile), resident);
+
+        QMutexLocker locker(&mutex);
+        if (waking) {
+            ++wakeReloads;
+            wakeReloadMs += total.elapsed();
+            lines << QString("✓ Reloaded on demand after %1 eviction(s); %2 on-demand reload(s), %3 ms on average")
+                         .arg(evictions).arg(wakeReloads).arg(wakeReloadMs / wakeReloads);
+        }
+    } else if (previous && previous->clamEngine()) {
+        // A half-written update must not knock us back to basic detection;
+        // keep the engine we have and try again on the next change
+        lines << QString("⚠ Signature reload failed, keeping the current engine: %1")
+                     .arg(warning.section('\n', 0, 0));
+        {
+            QMutexLocker locker(&mutex);
+            log = lines;
+        }
+        emit stateChanged(Ready);
+        QMetaObject::invokeMethod(this, &EngineService::loadFinished, Qt::QueuedConnection);
+        return;
+    } else {
+        engine = ScanEngine::builtIn(builtInSignatures());
+        state = Degraded;
+        lines << "⚠ Using basic signature detection (ClamAV not available)";
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        current = engine;
+        waking = false;
+        loadedStamp = stamp;
+        engineGeneration.fetchAndAddRelease(1);
+        log = lines;
+        // Only the first load warns; reloads just report in the log
+        if (!previous) {
+            warningText = warning;
+        }
+        currentState = state;
+    }
+    engineAvailable.wakeAll();
+    // The previous engine is released here; scans still holding it keep
+    // it alive until they move on to the new one
+    previous.reset();
+
+    // Emitted from the loader thread; receivers get it queued
+    emit stateChanged(state);
+    QMetaObject::invokeMethod(this, &EngineService::loadFinished, Qt::QueuedConnection);
+}
+
+QMap<QString, QString> EngineService::builtInSignatures()
+{
+    // Fallback signatures if ClamAV is not available
+    QMap<QString, QString> signatures;
+    signatures["EICAR-Test"] = "X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*";
+    signatures["TestVirus-A"] = "TEST-VIRUS-SIGNATURE-ALPHA-2024";
+    signatures["TestVirus-B"] = "DEMO-MALWARE-PATTERN-BETA";
+    return signatures;
+}
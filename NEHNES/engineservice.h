@@ -0,0 +1,139 @@
+#ifndef ENGINESERVICE_H
+#define ENGINESERVICE_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QStringList>
+#include "scanengine.h"
+
+class QFileSystemWatcher;
+class QThread;
+class QTimer;
+
+// Application-wide owner of the scan engine.
+//
+// Created once in main() and handed to every scan entry point, so the
+// ClamAV database is loaded and compiled once per process instead of once
+// per dialog. Loading runs on a background thread started at launch; the
+// UI follows state() and stateChanged(). Callers take a reference with
+// engine() and keep it for as long as they scan.
+//
+// When the database directory changes, a new engine is built in the
+// background and published in one step; holders of the old engine keep
+// using it, and it is freed when the last of them lets go.
+//
+// An engine nobody has scanned with for the idle timeout (sooner when the
+// system is short of memory) is unloaded and its memory handed back to the
+// OS; the next scan reloads it through waitForEngine().
+class EngineService : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        NotLoaded,
+        Loading,
+        Ready,    // ClamAV engine loaded
+        Degraded, // ClamAV unavailable, built-in signatures only
+        Evicted   // unloaded while idle; reloads on the next scan
+    };
+    Q_ENUM(State)
+
+    explicit EngineService(QObject *parent = nullptr);
+    ~EngineService();
+
+    // Starts loading on a background thread; does nothing if a load has
+    // already been started
+    void startLoading();
+    // Builds a fresh engine from the current databases and swaps it in.
+    // Scans keep running on the old engine in the meantime.
+    void reload();
+    // Pulls updates from mirror (URL or local directory) into the database
+    // directory and reloads if anything changed. Returns false if a load
+    // is already running.
+    bool updateSignatures(const QString& mirror);
+
+    // Which part of the database to load. Changing it after the first
+    // load rebuilds the engine in the background.
+    void setProfile(ScanEngine::Profile profile);
+    ScanEngine::Profile profile() const;
+
+    State state() const;
+    // Null until the state is Ready or Degraded. generation, if given,
+    // receives the generation of the returned engine.
+    QSharedPointer<ScanEngine> engine(int *generation = nullptr) const;
+    // Bumped each time a new engine is published. Lock-free, so scan
+    // workers can poll it for every file.
+    int generation() const;
+
+    // For scan threads (never the GUI thread): waits up to timeoutMs for an
+    // engine, reloading an evicted one first. Null on timeout.
+    QSharedPointer<ScanEngine> waitForEngine(int *generation, int timeoutMs);
+
+    // Scans bracket their work with these; an engine in use is never evicted
+    void beginScan();
+    void endScan();
+
+    // Minutes without a scan before the engine is unloaded; 0 keeps it
+    // loaded for good
+    void setIdleTimeout(int minutes);
+
+    // Lines describing the loaded engine, for the scan log
+    QStringList loadLog() const;
+    // Why ClamAV is not being used. Returned once, so the first window to
+    // ask can show it and later ones do not nag.
+    QString takeWarning();
+
+    static QStringList databaseLocations();
+
+signals:
+    // Also emitted (with the same state) after every reload
+    void stateChanged(EngineService::State state);
+
+private slots:
+    void loadFinished();
+    void databasesChanged();
+    void checkIdle();
+    void wake();
+
+private:
+    mutable QMutex mutex;
+    State currentState;
+    ScanEngine::Profile engineProfile;
+    QSharedPointer<ScanEngine> current;
+    QStringList log;
+    QString warningText;
+    QAtomicInt engineGeneration;
+    QThread *loader;
+    bool reloadPending;
+    bool clamInitialized;
+    QFileSystemWatcher *watcher;
+    QTimer *reloadTimer;
+    // Names, sizes and times of the database files behind the current
+    // engine, so directory events that change nothing do not reload
+    QString loadedStamp;
+
+    QWaitCondition engineAvailable;
+    int activeScans;
+    QElapsedTimer idleClock;
+    int idleTimeoutMinutes;
+    QTimer *idleTimer;
+    int evictions;
+    int wakeReloads;
+    qint64 wakeReloadMs;
+    bool waking;
+
+    void startLoader();
+    void load(const QStringList& preface = QStringList());
+    void watchDatabases();
+    static QString findDatabase();
+    static QString databaseStamp(const QString& directory);
+    QString updateDirectory() const;
+    static QMap<QString, QString> builtInSignatures();
+};
+
+#endif // ENGINESERVICE_H
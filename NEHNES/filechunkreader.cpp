@@ -0,0 +1,148 @@
+#include "filechunkreader.h"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+FileChunkReader::FileChunkReader(const QString& path, qint64 chunkSize)
+    : handle(path)
+    , file(path)
+    , borrowedFd(-1)
+    , chunkSize(chunkSize)
+    , fileSize(0)
+    , position(0)
+    , dataEnd(0)
+    , sequential(false)
+    , error(false)
+{
+}
+
+FileChunkReader::FileChunkReader(int fd, qint64 chunkSize)
+    : handle(QString())
+    , borrowedFd(fd)
+    , chunkSize(chunkSize)
+    , fileSize(0)
+    , position(0)
+    , dataEnd(0)
+    , sequential(false)
+    , error(false)
+{
+}
+
+qint64 FileChunkReader::defaultChunkSize()
+{
+    // Large enough that the syscalls do not matter next to the matching,
+    // small enough to keep one per worker even on a Raspberry Pi
+    return 1024 * 1024;
+}
+
+bool FileChunkReader::open()
+{
+    bool opened;
+    if (borrowedFd >= 0) {
+        opened = file.open(borrowedFd, QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::DontCloseHandle);
+    } else {
+        opened = handle.open()
+            ? file.open(handle.descriptor(), QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::DontCloseHandle)
+            : file.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+    if (!opened) {
+        error = true;
+        return false;
+    }
+
+    sequential = file.isSequential();
+    fileSize = sequential ? 0 : file.size();
+    return true;
+}
+
+bool FileChunkReader::next(const uchar *&data, qint64& length, qint64& offset)
+{
+    if (sequential) {
+        offset = position;
+        return readChunk(data, length);
+    }
+
+    if (error || (position >= dataEnd && !findData())) {
+        return false;
+    }
+
+    length = qMin(chunkSize, dataEnd - position);
+    offset = position;
+    return readChunk(data, length);
+}
+
+bool FileChunkReader::readChunk(const uchar *&data, qint64& length)
+{
+    if (buffer.size() < chunkSize) {
+        buffer.resize(int(chunkSize));
+    }
+
+    qint64 got;
+    if (sequential) {
+        got = file.read(buffer.data(), chunkSize);
+    } else {
+#ifdef Q_OS_UNIX
+        do {
+            got = ::pread(file.handle(), buffer.data(), size_t(length), off_t(position));
+        } while (got < 0 && errno == EINTR);
+#else
+        got = file.seek(position) ? file.read(buffer.data(), length) : -1;
+#endif
+    }
+    if (got <= 0) {
+        error = got < 0;
+        if (got == 0 && !sequential) {
+            // The file shrank under us; whatever was cut off is not there
+            // to scan any more
+            fileSize = position;
+            dataEnd = position;
+        }
+        return false;
+    }
+
+    length = got;
+    data = reinterpret_cast<const uchar*>(buffer.constData());
+    position += got;
+    return true;
+}
+
+bool FileChunkReader::findData()
+{
+    if (position >= fileSize) {
+        return false;
+    }
+
+#if defined(Q_OS_UNIX) && defined(SEEK_DATA)
+    // Jump over holes instead of reading pages of zeros
+    off_t start = ::lseek(file.handle(), off_t(position), SEEK_DATA);
+    if (start < 0) {
+        // ENXIO: nothing but a hole up to the end of the file
+        error = (errno != ENXIO && errno != EINVAL);
+        if (errno == EINVAL) {
+            // Filesystem without hole reporting
+            dataEnd = fileSize;
+            return true;
+        }
+        return false;
+    }
+
+    off_t end = ::lseek(file.handle(), start, SEEK_HOLE);
+    position = qint64(start);
+    dataEnd = end > start ? qMin(qint64(end), fileSize) : fileSize;
+#else
+    dataEnd = fileSize;
+#endif
+    return true;
+}
+
+bool FileChunkReader::hasError() const
+{
+    return error;
+}
+
+qint64 FileChunkReader::size() const
+{
+    return fileSize;
+}
@@ -0,0 +1,51 @@
+#ifndef FILECHUNKREADER_H
+#define FILECHUNKREADER_H
+
+#include <QFile>
+#include <QByteArray>
+#include "scanfilehandle.h"
+
+// Walks a file as a sequence of read-only chunks without ever holding the
+// whole file in memory. Every chunk is read with pread() into one fixed
+// buffer, so peak memory does not depend on the file size. Nothing is
+// mapped: a file truncated while we read it (a log, a download) just ends
+// early instead of raising SIGBUS in whichever process is scanning it.
+// Holes in sparse files are skipped; callers see them as a gap between the
+// end of one chunk and the next offset. Pipes and other sequential devices
+// are read until EOF.
+class FileChunkReader
+{
+public:
+    explicit FileChunkReader(const QString& path, qint64 chunkSize = defaultChunkSize());
+    // Reads a descriptor somebody else opened (and closes)
+    explicit FileChunkReader(int fd, qint64 chunkSize = defaultChunkSize());
+
+    static qint64 defaultChunkSize();
+
+    bool open();
+
+    // Returns the next chunk and its absolute offset, or false at the end of
+    // the file (or on a read error, see hasError()). The data stays valid
+    // until the next call.
+    bool next(const uchar *&data, qint64& length, qint64& offset);
+
+    bool hasError() const;
+    qint64 size() const;
+
+private:
+    ScanFileHandle handle;
+    QFile file;
+    int borrowedFd;
+    qint64 chunkSize;
+    qint64 fileSize;
+    qint64 position;
+    qint64 dataEnd;
+    bool sequential;
+    bool error;
+    QByteArray buffer;
+
+    bool findData();
+    bool readChunk(const uchar *&data, qint64& length);
+};
+
+#endif // FILECHUNKREADER_H
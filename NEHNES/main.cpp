@@ -1,11 +1,26 @@
-#include "mainwindow.h"
-
-#include <QApplication>
-
-int main(int argc, char *argv[])
-{
-    QApplication a(argc, argv);
-    MainWindow w;
-    w.show();
-    return a.exec();
-}
+#include "mainwindow.h"
+#include "engineservice.h"
+#include "scandaemonclient.h"
+
+#include <QApplication>
+#include <QSettings>
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    QCoreApplication::setOrganizationName("NEHNES");
+    QCoreApplication::setApplicationName("NEHNES");
+
+    // One engine for the whole application, shared by every scan. It loads
+    // in the background while the window comes up, unless nehnes-scand is
+    // running and already has one loaded for the whole host.
+    EngineService engines;
+    engines.setProfile(ScanEngine::profileFromName(QSettings().value("engine/profile").toString()));
+    engines.setIdleTimeout(QSettings().value("engine/idleMinutes", 30).toInt());
+    if (!ScanDaemonClient::isAvailable()) {
+        engines.startLoading();
+    }
+    MainWindow w(&engines);
+    w.show();
+    return a.exec();
+}
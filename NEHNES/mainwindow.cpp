@@ -1,30 +1,36 @@
-#include "mainwindow.h"
-#include "ui_mainwindow.h"
-
-MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent)
-    , ui(new Ui::MainWindow)
-{
-    ui->setupUi(this);
-
-
-    connect(ui->settingsButton, &QPushButton::clicked, this, &MainWindow::onSettingsClicked);
-    connect(ui->antivirusButton, &QPushButton::clicked, this, &MainWindow::onAntivirusClicked);
-}
-
-MainWindow::~MainWindow()
-{
-    delete ui;
-}
-
-void MainWindow::onSettingsClicked()
-{
-    Settings_H settingsDialog(this);
-    settingsDialog.exec();
-}
-
-void MainWindow::onAntivirusClicked()
-{
-    Antivirus antivirusDialog(this);
-    antivirusDialog.exec();
-}
+#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include <QSettings>
+
+MainWindow::MainWindow(EngineService *engines, QWidget *parent)
+    : QMainWindow(parent)
+    , ui(new Ui::MainWindow)
+    , engines(engines)
+{
+    ui->setupUi(this);
+
+
+    connect(ui->settingsButton, &QPushButton::clicked, this, &MainWindow::onSettingsClicked);
+    connect(ui->antivirusButton, &QPushButton::clicked, this, &MainWindow::onAntivirusClicked);
+}
+
+MainWindow::~MainWindow()
+{
+    delete ui;
+}
+
+void MainWindow::onSettingsClicked()
+{
+    Settings_H settingsDialog(this);
+    if (settingsDialog.exec() == QDialog::Accepted) {
+        // A different profile rebuilds the engine in the background
+        engines->setProfile(ScanEngine::profileFromName(QSettings().value("engine/profile").toString()));
+        engines->setIdleTimeout(QSettings().value("engine/idleMinutes", 30).toInt());
+    }
+}
+
+void MainWindow::onAntivirusClicked()
+{
+    Antivirus antivirusDialog(engines, this);
+    antivirusDialog.exec();
+}
@@ -1,28 +1,30 @@
-#ifndef MAINWINDOW_H
-#define MAINWINDOW_H
-
-#include <QMainWindow>
-#include "settings.h"
-#include "antivirus.h"
-
-QT_BEGIN_NAMESPACE
-namespace Ui { class MainWindow; }
-QT_END_NAMESPACE
-
-class MainWindow : public QMainWindow
-{
-    Q_OBJECT
-
-public:
-    MainWindow(QWidget *parent = nullptr);
-    ~MainWindow();
-
-private slots:
-    void onSettingsClicked();
-    void onAntivirusClicked();
-
-private:
-    Ui::MainWindow *ui;
-};
-
-#endif
+#ifndef MAINWINDOW_H
+#define MAINWINDOW_H
+
+#include <QMainWindow>
+#include "settings.h"
+#include "antivirus.h"
+#include "engineservice.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui { class MainWindow; }
+QT_END_NAMESPACE
+
+class MainWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    MainWindow(EngineService *engines, QWidget *parent = nullptr);
+    ~MainWindow();
+
+private slots:
+    void onSettingsClicked();
+    void onAntivirusClicked();
+
+private:
+    Ui::MainWindow *ui;
+    EngineService *engines;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "memorypressure.h"
+#include <QFile>
+#include <QLocale>
+#include <QStringList>
+
+namespace {
+
+// Stalls above this mean the kernel is already reclaiming hard
+const double StallThreshold = 10.0;
+// Less than this share of RAM available counts as tight
+const double AvailableThreshold = 0.15;
+
+}
+
+MemoryPressure MemoryPressure::sample()
+{
+    MemoryPressure pressure;
+
+#ifdef Q_OS_LINUX
+    // "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345"
+    QFile psi("/proc/pressure/memory");
+    if (psi.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = psi.readLine().simplified().split(' ');
+        for (const QByteArray& field : fields) {
+            if (field.startsWith("avg10=")) {
+                pressure.stallPercent = field.mid(6).toDouble();
+            }
+        }
+    }
+
+    QFile meminfo("/proc/meminfo");
+    if (meminfo.open(QIODevice::ReadOnly)) {
+        while (!meminfo.atEnd()) {
+            const QList<QByteArray> fields = meminfo.readLine().simplified().split(' ');
+            if (fields.size() < 2) {
+                continue;
+            }
+            if (fields.at(0) == "MemTotal:") {
+                pressure.totalBytes = fields.at(1).toLongLong() * 1024;
+            } else if (fields.at(0) == "MemAvailable:") {
+                pressure.availableBytes = fields.at(1).toLongLong() * 1024;
+            }
+        }
+    }
+#endif
+
+    return pressure;
+}
+
+bool MemoryPressure::isHigh() const
+{
+    if (stallPercent >= StallThreshold) {
+        return true;
+    }
+    return totalBytes > 0 && availableBytes >= 0
+           && availableBytes < qint64(totalBytes * AvailableThreshold);
+}
+
+QString MemoryPressure::describe() const
+{
+    QStringList parts;
+    if (stallPercent >= 0) {
+        parts << QString("%1% stalled").arg(stallPercent, 0, 'f', 1);
+    }
+    if (totalBytes > 0 && availableBytes >= 0) {
+        parts << QString("%1 of %2 available")
+                     .arg(QLocale().formattedDataSize(availableBytes),
+                          QLocale().formattedDataSize(totalBytes));
+    }
+    return parts.isEmpty() ? QString("unknown") : parts.join(", ");
+}
@@ -0,0 +1,23 @@
+#ifndef MEMORYPRESSURE_H
+#define MEMORYPRESSURE_H
+
+#include <QString>
+
+// Snapshot of how hard the system is pressed for memory, from the kernel's
+// pressure stall information (/proc/pressure/memory, Linux 4.20+) and
+// /proc/meminfo. Elsewhere every field stays unknown and isHigh() is false.
+struct MemoryPressure
+{
+    // Share of the last 10 s in which some task stalled on memory, in
+    // percent; -1 when PSI is not available
+    double stallPercent = -1;
+    qint64 availableBytes = -1;
+    qint64 totalBytes = -1;
+
+    static MemoryPressure sample();
+
+    bool isHigh() const;
+    QString describe() const;
+};
+
+#endif // MEMORYPRESSURE_H
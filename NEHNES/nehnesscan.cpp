@@ -0,0 +1,394 @@
+#include "directorywalker.h"
+#include "engineservice.h"
+#include "scandaemonclient.h"
+#include "scanjob.h"
+#include "scanqueue.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+
+#include <csignal>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Exit status, for cron jobs and scripts
+enum ExitCode {
+    Clean = 0,
+    ThreatsFound = 1,
+    // Bad arguments, a scan that failed or was interrupted, or any file or
+    // directory that could not be read (as clamscan does)
+    ScanError = 2
+};
+
+enum class Format { Text, Json, Csv };
+
+QString csvField(const QString& value)
+{
+    if (!value.contains(',') && !value.contains('"') && !value.contains('\n')) {
+        return value;
+    }
+    QString quoted = value;
+    quoted.replace('"', "\"\"");
+    return '"' + quoted + '"';
+}
+
+QString jsonLine(const QJsonObject& object)
+{
+    return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+// Lists the paths without scanning anything, to benchmark the walkers
+int walkOnly(const QStringList& paths, DirectoryWalker::Method method, int walkers, Format format,
+             QTextStream& out, QTextStream& err)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    ScanQueue queue(1);
+    qint64 files = 0;
+    qint64 bytes = 0;
+    QThread *drain = QThread::create([&queue, &files, &bytes] {
+        ScanItem item;
+        while (queue.pop(0, item)) {
+            ++files;
+            bytes += item.size;
+        }
+    });
+    drain->start();
+
+    DirectoryWalker walker(paths, &queue);
+    walker.setMethod(method);
+    walker.setThreadCount(walkers);
+    walker.walk();
+    drain->wait();
+    delete drain;
+
+    qint64 elapsedMs = qMax<qint64>(1, clock.elapsed());
+    double filesPerSecond = files * 1000.0 / elapsedMs;
+    QString methodName = method == DirectoryWalker::Native ? "native" : "qt";
+    // Only the native walker lists directories in parallel
+    int threads = method == DirectoryWalker::Native ? walkers : 1;
+
+    if (format == Format::Json) {
+        out << jsonLine({{"type", "walk"},
+                         {"walker", methodName},
+                         {"walkers", threads},
+                         {"files", files},
+                         {"bytes", bytes},
+                         {"errors", walker.errors()},
+                         {"elapsedMs", elapsedMs},
+                         {"filesPerSecond", filesPerSecond}})
+            << Qt::endl;
+    } else {
+        err << "Walker: " << methodName << ", " << threads << " thread(s)\n"
+            << "Listed files: " << files << " (" << QLocale().formattedDataSize(bytes) << ")\n"
+            << "Unreadable directories: " << walker.errors() << '\n'
+            << "Walk time: " << elapsedMs << " ms, "
+            << QString::number(filesPerSecond, 'f', 0) << " files/s" << Qt::endl;
+    }
+    return walker.errors() > 0 ? ScanError : Clean;
+}
+
+#ifdef Q_OS_UNIX
+int signalPipe[2] = { -1, -1 };
+
+void onInterrupt(int)
+{
+    char byte = 1;
+    ssize_t ignored = ::write(signalPipe[1], &byte, 1);
+    Q_UNUSED(ignored);
+}
+#endif
+
+}
+
+// nehnes-scan: the scan pipeline without any widgets, for cron, SSH
+// sessions and benchmarks. Detections go to stdout as they are found,
+// statistics to stderr.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("NEHNES");
+    QCoreApplication::setApplicationName("NEHNES");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Scan files and directories for malware.\n"
+                                     "Exit status: 0 clean, 1 threats found, 2 error "
+                                     "(including files or directories that could not be read).");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "Files or directories to scan.", "paths...");
+    QCommandLineOption threadsOption({"j", "threads"},
+                                     "Scan with <n> worker threads (default: one per core).", "n");
+    QCommandLineOption readersOption("readers", "Read files ahead with <n> I/O threads.", "n");
+    QCommandLineOption formatOption({"f", "format"},
+                                    "Print detections as text, json (one object per line) or csv.",
+                                    "format", "text");
+    QCommandLineOption profileOption("profile",
+                                     "Engine profile: full, balanced or lite (default: as in Settings).",
+                                     "profile");
+    QCommandLineOption daemonOption("daemon", "Scan through nehnes-scand if it is running.");
+    QCommandLineOption quietOption({"q", "quiet"}, "Do not print statistics.");
+    QCommandLineOption walkerOption("walker",
+                                    "List directories with the native (getdents64) or qt walker.",
+                                    "walker",
+                                    DirectoryWalker::defaultMethod() == DirectoryWalker::Native ? "native" : "qt");
+    QCommandLineOption walkersOption("walkers",
+                                     "List directories with <n> threads (default: as in Settings).", "n");
+    QCommandLineOption walkOnlyOption("walk-only", "Only list the files and time the walk; scan nothing.");
+    parser.addOptions({threadsOption, readersOption, formatOption, profileOption,
+                       daemonOption, quietOption, walkerOption, walkersOption, walkOnlyOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QStringList paths = parser.positionalArguments();
+    if (paths.isEmpty()) {
+        err << "nehnes-scan: no paths given (see --help)" << Qt::endl;
+        return ScanError;
+    }
+    for (const QString& path : paths) {
+        if (!QFileInfo::exists(path)) {
+            err << "nehnes-scan: " << path << ": no such file or directory" << Qt::endl;
+            return ScanError;
+        }
+    }
+
+    Format format;
+    QString formatName = parser.value(formatOption).toLower();
+    if (formatName == "text") {
+        format = Format::Text;
+    } else if (formatName == "json") {
+        format = Format::Json;
+    } else if (formatName == "csv") {
+        format = Format::Csv;
+    } else {
+        err << "nehnes-scan: unknown format \"" << formatName << "\" (text, json or csv)" << Qt::endl;
+        return ScanError;
+    }
+
+    int threads = 0;
+    int readers = 0;
+    bool ok = true;
+    if (parser.isSet(threadsOption)) {
+        threads = parser.value(threadsOption).toInt(&ok);
+    }
+    if (ok && parser.isSet(readersOption)) {
+        readers = parser.value(readersOption).toInt(&ok);
+    }
+    int walkers = QSettings().value("scan/walkerThreads", DirectoryWalker::defaultThreadCount()).toInt();
+    if (ok && parser.isSet(walkersOption)) {
+        walkers = parser.value(walkersOption).toInt(&ok);
+    }
+    if (!ok || threads < 0 || readers < 0 || walkers < 1) {
+        err << "nehnes-scan: thread counts must be positive numbers" << Qt::endl;
+        return ScanError;
+    }
+
+    DirectoryWalker::Method walker;
+    QString walkerName = parser.value(walkerOption).toLower();
+    if (walkerName == "native") {
+        walker = DirectoryWalker::Native;
+    } else if (walkerName == "qt") {
+        walker = DirectoryWalker::Portable;
+    } else {
+        err << "nehnes-scan: unknown walker \"" << walkerName << "\" (native or qt)" << Qt::endl;
+        return ScanError;
+    }
+    if (walker == DirectoryWalker::Native && DirectoryWalker::defaultMethod() != DirectoryWalker::Native) {
+        err << "nehnes-scan: the native walker needs Linux; using qt" << Qt::endl;
+        walker = DirectoryWalker::Portable;
+    }
+
+    if (parser.isSet(walkOnlyOption)) {
+        return walkOnly(paths, walker, walkers, format, out, err);
+    }
+
+    QString profile = parser.isSet(profileOption)
+                          ? parser.value(profileOption)
+                          : QSettings().value("engine/profile").toString();
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 engineMs = -1;
+
+    EngineService engines;
+    engines.setProfile(ScanEngine::profileFromName(profile));
+    QObject::connect(&engines, &EngineService::stateChanged, &app,
+                     [&engines, &err, &engineMs, &clock](EngineService::State state) {
+        if (state != EngineService::Ready && state != EngineService::Degraded) {
+            return;
+        }
+        if (engineMs < 0) {
+            engineMs = clock.elapsed();
+        }
+        QString warning = engines.takeWarning();
+        if (!warning.isEmpty()) {
+            err << "nehnes-scan: warning: " << warning.section('\n', 0, 0) << Qt::endl;
+        }
+        if (state == EngineService::Degraded) {
+            err << "nehnes-scan: warning: ClamAV not available, using basic signature detection"
+                << Qt::endl;
+        }
+    });
+
+    ScanOptions options;
+    options.threads = threads;
+    options.readers = readers;
+    options.walker = walker;
+    options.walkerThreads = walkers;
+    options.preferDaemon = parser.isSet(daemonOption);
+    ScanJob *job = submitScan(paths, &engines, options);
+    bool viaDaemon = qobject_cast<ScanDaemonClient*>(job) != nullptr;
+    if (options.preferDaemon && !viaDaemon) {
+        err << "nehnes-scand is not running; scanning in-process" << Qt::endl;
+    }
+
+    if (format == Format::Csv) {
+        out << "path,threat,size" << Qt::endl;
+    }
+
+    int threats = 0;
+    bool failed = false;
+    bool interrupted = false;
+    int cacheHits = 0;
+    int cacheMisses = 0;
+    int duplicates = 0;
+    int errors = 0;
+
+    // Detections are printed as they come in, not at the end
+    auto collect = [job, format, &out, &threats] {
+        QVector<ScanJob::Result> batch;
+        while (job->takeResults(batch) > 0) {
+            for (const ScanJob::Result& result : batch) {
+                ++threats;
+                switch (format) {
+                case Format::Text:
+                    out << result.path << ": " << result.threatName << " FOUND\n";
+                    break;
+                case Format::Json:
+                    out << jsonLine({{"type", "threat"},
+                                     {"path", result.path},
+                                     {"threat", result.threatName},
+                                     {"size", result.size}})
+                        << '\n';
+                    break;
+                case Format::Csv:
+                    out << csvField(result.path) << ',' << csvField(result.threatName) << ','
+                        << result.size << '\n';
+                    break;
+                }
+            }
+            batch.clear();
+        }
+        out.flush();
+    };
+
+    QTimer poll;
+    poll.setInterval(50);
+    QObject::connect(&poll, &QTimer::timeout, &app, collect);
+
+    QObject::connect(job, &ScanJob::verdictCacheStats, &app, [&cacheHits, &cacheMisses](int hits, int misses) {
+        cacheHits = hits;
+        cacheMisses = misses;
+    });
+    QObject::connect(job, &ScanJob::duplicatesSkipped, &app, [&duplicates](int count) {
+        duplicates = count;
+    });
+    QObject::connect(job, &ScanJob::scanErrors, &app, [&errors](int count) {
+        errors = count;
+    });
+    QObject::connect(job, &ScanJob::scanFailed, &app, [&failed, &err](const QString& message) {
+        failed = true;
+        err << "nehnes-scan: " << message << Qt::endl;
+    });
+    QObject::connect(job, &ScanJob::scanComplete, &app, [&] {
+        poll.stop();
+        collect();
+
+        ScanJob::Progress progress = job->progress();
+        qint64 totalMs = clock.elapsed();
+        // Throughput counts the scan itself, not loading the signatures
+        qint64 scanMs = qMax<qint64>(1, totalMs - qMax<qint64>(0, engineMs));
+        double filesPerSecond = progress.files * 1000.0 / scanMs;
+        double bytesPerSecond = progress.bytes * 1000.0 / scanMs;
+
+        if (format == Format::Json) {
+            out << jsonLine({{"type", "summary"},
+                             {"files", progress.files},
+                             {"bytes", progress.bytes},
+                             {"threats", threats},
+                             {"engineMs", engineMs},
+                             {"totalMs", totalMs},
+                             {"filesPerSecond", filesPerSecond},
+                             {"bytesPerSecond", bytesPerSecond},
+                             {"cacheHits", cacheHits},
+                             {"cacheMisses", cacheMisses},
+                             {"duplicates", duplicates},
+                             {"errors", errors},
+                             {"interrupted", interrupted}})
+                << Qt::endl;
+        }
+
+        if (!parser.isSet(quietOption)) {
+            QLocale locale;
+            err << "\n----------- SCAN SUMMARY -----------\n"
+                << "Scanned files: " << progress.files << '\n'
+                << "Scanned data: " << locale.formattedDataSize(progress.bytes) << '\n'
+                << "Threats found: " << threats << '\n'
+                << "Scan errors: " << errors << '\n';
+            if (viaDaemon) {
+                err << "Engine: shared through nehnes-scand\n";
+            } else if (engineMs >= 0) {
+                err << "Engine ready: " << engineMs << " ms\n";
+            }
+            err << "Scan time: " << scanMs << " ms (" << totalMs << " ms total)\n"
+                << "Throughput: " << QString::number(filesPerSecond, 'f', 1) << " files/s, "
+                << locale.formattedDataSize(qint64(bytesPerSecond)) << "/s\n"
+                << "Verdict cache: " << cacheHits << " hit(s), " << cacheMisses << " miss(es)\n"
+                << "Identical copies not rescanned: " << duplicates << Qt::endl;
+        }
+
+        if (failed || interrupted || errors > 0) {
+            app.exit(ScanError);
+        } else {
+            app.exit(threats > 0 ? ThreatsFound : Clean);
+        }
+    });
+
+#ifdef Q_OS_UNIX
+    // Ctrl+C stops the scan but still prints what was found so far
+    if (::pipe(signalPipe) == 0) {
+        QSocketNotifier *stop = new QSocketNotifier(signalPipe[0], QSocketNotifier::Read, &app);
+        QObject::connect(stop, &QSocketNotifier::activated, &app, [job, &interrupted, stop] {
+            stop->setEnabled(false);
+            interrupted = true;
+            job->requestInterruption();
+        });
+        std::signal(SIGINT, onInterrupt);
+        std::signal(SIGTERM, onInterrupt);
+    }
+#endif
+
+    job->start();
+    poll.start();
+    int status = app.exec();
+
+    job->wait();
+    delete job;
+    return status;
+}
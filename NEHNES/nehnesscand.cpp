@@ -0,0 +1,81 @@
+#include "engineservice.h"
+#include "scandaemon.h"
+#include "scanprotocol.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QTextStream>
+
+#include <csignal>
+#include <unistd.h>
+
+namespace {
+
+int signalPipe[2] = { -1, -1 };
+
+// Only async-signal-safe work here; the event loop picks it up
+void onTerminate(int)
+{
+    char byte = 1;
+    ssize_t ignored = ::write(signalPipe[1], &byte, 1);
+    Q_UNUSED(ignored);
+}
+
+}
+
+// nehnes-scand: keeps one scan engine loaded for every NEHNES process of
+// the user and scans on their behalf over a Unix domain socket
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("NEHNES");
+    QCoreApplication::setApplicationName("NEHNES");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("NEHNES scan daemon");
+    parser.addHelpOption();
+    QCommandLineOption socketOption("socket", "Listen on <path>.", "path", ScanProtocol::socketPath());
+    parser.addOption(socketOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    // Same settings as the GUI, so both pick the same profile
+    EngineService engines;
+    engines.setProfile(ScanEngine::profileFromName(QSettings().value("engine/profile").toString()));
+    engines.setIdleTimeout(QSettings().value("engine/idleMinutes", 30).toInt());
+    QObject::connect(&engines, &EngineService::stateChanged, &app, [&engines, &err](EngineService::State state) {
+        if (state == EngineService::Loading) {
+            return;
+        }
+        for (const QString& line : engines.loadLog()) {
+            err << line << Qt::endl;
+        }
+        QString warning = engines.takeWarning();
+        if (!warning.isEmpty()) {
+            err << warning << Qt::endl;
+        }
+    });
+
+    ScanDaemon daemon(&engines);
+    QString error;
+    if (!daemon.listen(parser.value(socketOption), error)) {
+        err << error << Qt::endl;
+        return 1;
+    }
+    engines.startLoading();
+
+    // Leave through the event loop, so the socket file is removed
+    if (::pipe(signalPipe) == 0) {
+        QSocketNotifier *terminate = new QSocketNotifier(signalPipe[0], QSocketNotifier::Read, &app);
+        QObject::connect(terminate, &QSocketNotifier::activated, &app, &QCoreApplication::quit);
+        std::signal(SIGTERM, onTerminate);
+        std::signal(SIGINT, onTerminate);
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    err << "nehnes-scand listening on " << parser.value(socketOption) << Qt::endl;
+    return app.exec();
+}
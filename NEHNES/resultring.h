@@ -0,0 +1,119 @@
+#ifndef RESULTRING_H
+#define RESULTRING_H
+
+#include <QAtomicInteger>
+#include <QThread>
+#include <QVector>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free queue for many producers and one consumer (the scheme
+// from Dmitry Vyukov's bounded MPMC queue, with a plain consumer index).
+//
+// Scan workers push result records without locking or posting events; the
+// UI thread drains whatever has accumulated in one go. When the ring is full
+// producers wait for the consumer instead of letting memory grow.
+template <typename T>
+class ResultRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit ResultRing(int capacity)
+        : dequeuePos(0)
+    {
+        quintptr size = 2;
+        while (size < quintptr(capacity)) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (quintptr i = 0; i < size; ++i) {
+            cells[i].sequence.storeRelaxed(i);
+        }
+        enqueuePos.storeRelaxed(0);
+    }
+
+    // Returns false if the ring is full; item is left untouched then
+    bool tryPush(T& item)
+    {
+        quintptr pos = enqueuePos.loadRelaxed();
+        Cell *cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            qintptr diff = qintptr(cell->sequence.loadAcquire()) - qintptr(pos);
+            if (diff == 0) {
+                if (enqueuePos.testAndSetRelaxed(pos, pos + 1, pos)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.loadRelaxed();
+            }
+        }
+
+        cell->value = std::move(item);
+        cell->sequence.storeRelease(pos + 1);
+        return true;
+    }
+
+    // Blocks while the ring is full. Gives up (returning false) once
+    // stopped() says the consumer is gone.
+    template <typename StopFn>
+    bool push(T item, StopFn stopped)
+    {
+        for (int attempt = 0; !tryPush(item); ++attempt) {
+            if (stopped()) {
+                return false;
+            }
+            if (attempt < 64) {
+                QThread::yieldCurrentThread();
+            } else {
+                QThread::msleep(1);
+            }
+        }
+        return true;
+    }
+
+    // Consumer side: moves up to max queued items into out
+    int drain(QVector<T>& out, int max)
+    {
+        int taken = 0;
+        while (taken < max) {
+            Cell& cell = cells[dequeuePos & mask];
+            qintptr diff = qintptr(cell.sequence.loadAcquire()) - qintptr(dequeuePos + 1);
+            if (diff < 0) {
+                break;
+            }
+
+            out.append(std::move(cell.value));
+            cell.value = T();
+            cell.sequence.storeRelease(dequeuePos + mask + 1);
+            ++dequeuePos;
+            ++taken;
+        }
+        return taken;
+    }
+
+    int capacity() const
+    {
+        return int(mask + 1);
+    }
+
+private:
+    struct Cell
+    {
+        QAtomicInteger<quintptr> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    quintptr mask;
+
+    // Producers and the consumer hammer different ends; keep them on
+    // separate cache lines
+    alignas(64) QAtomicInteger<quintptr> enqueuePos;
+    alignas(64) quintptr dequeuePos;
+};
+
+#endif // RESULTRING_H
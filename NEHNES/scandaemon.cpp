@@ -0,0 +1,390 @@
+#include "scandaemon.h"
+#include "antivirusscanner.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QSocketNotifier>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace ScanProtocol;
+
+namespace {
+
+// The socket is private to the user, but a path scan runs with the
+// daemon's rights, so check who is on the other end anyway
+bool peerIsSameUser(int fd)
+{
+#ifdef Q_OS_LINUX
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    return credentials.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) != 0) {
+        return false;
+    }
+    return uid == geteuid();
+#endif
+}
+
+}
+
+ScanSession::ScanSession(int socket, EngineService *engines, QObject *parent)
+    : QThread(parent)
+    , socket(socket)
+    , engines(engines)
+{
+}
+
+ScanSession::~ScanSession()
+{
+    ::close(socket);
+}
+
+void ScanSession::run()
+{
+    while (!isInterruptionRequested()) {
+        if (!waitReadable(socket, 200)) {
+            continue;
+        }
+
+        Frame frame;
+        int fd = -1;
+        if (!receiveFrame(socket, frame, &fd)) {
+            // Client hung up (or spoke garbage)
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return;
+        }
+
+        switch (frame.type) {
+        case ScanPaths: {
+            QStringList paths;
+            if (!unpack(frame.payload, paths)) {
+                sendError("Malformed path list");
+                break;
+            }
+            // A relative path means the client's working directory, which
+            // we do not know; resolving it against ours scans the wrong tree
+            auto relative = std::find_if(paths.cbegin(), paths.cend(), [](const QString& path) {
+                return !QDir::isAbsolutePath(path);
+            });
+            if (relative != paths.cend()) {
+                sendError(QString("%1 is not an absolute path").arg(*relative));
+            } else {
+                scanPaths(paths);
+            }
+            break;
+        }
+        case ScanDescriptor: {
+            QString name;
+            if (fd >= 0 && unpack(frame.payload, name)) {
+                scanDescriptor(fd, name);
+                fd = -1;
+            } else {
+                sendError("ScanDescriptor needs a name and a descriptor");
+            }
+            break;
+        }
+        case StreamBegin: {
+            QString name;
+            if (!unpack(frame.payload, name)) {
+                sendError("Malformed stream header");
+                return;
+            }
+            scanStream(name);
+            break;
+        }
+        case Cancel:
+            // Nothing running
+            break;
+        default:
+            sendError(QString("Unknown request type %1").arg(frame.type));
+            break;
+        }
+
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+void ScanSession::scanPaths(const QStringList& paths)
+{
+    // The same pipeline the GUI runs in-process, fed from the shared engine
+    AntivirusScanner scanner(paths, engines);
+    scanner.setWalkerThreadCount(QSettings().value("scan/walkerThreads",
+                                                   DirectoryWalker::defaultThreadCount()).toInt());
+
+    QAtomicInt discovered(-1);
+    QAtomicInt cacheHits(0);
+    QAtomicInt cacheMisses(0);
+    QAtomicInt duplicates(0);
+    QAtomicInt errors(0);
+    // Emitted on the scanner's threads; only this thread writes the socket
+    connect(&scanner, &ScanJob::discoveryComplete, [&discovered](int total) {
+        discovered.storeRelease(total);
+    });
+    connect(&scanner, &ScanJob::verdictCacheStats, [&cacheHits, &cacheMisses](int hits, int misses) {
+        cacheHits.storeRelease(hits);
+        cacheMisses.storeRelease(misses);
+    });
+    connect(&scanner, &ScanJob::duplicatesSkipped, [&duplicates](int count) {
+        duplicates.storeRelease(count);
+    });
+    connect(&scanner, &ScanJob::scanErrors, [&errors](int count) {
+        errors.storeRelease(count);
+    });
+
+    scanner.start();
+
+    bool clientGone = false;
+    bool discoverySent = false;
+    qint64 lastFiles = -1;
+    QVector<ScanJob::Result> batch;
+    for (;;) {
+        bool finished = scanner.wait(50);
+
+        // Detections go out as soon as they are found
+        batch.clear();
+        scanner.takeResults(batch);
+        for (const ScanJob::Result& result : batch) {
+            clientGone = clientGone
+                || !sendFrame(socket, Threat, pack(result.path, result.threatName,
+                                                   result.size, result.detectedAt));
+        }
+
+        if (!discoverySent && discovered.loadAcquire() >= 0) {
+            discoverySent = true;
+            clientGone = clientGone || !sendFrame(socket, Discovered, pack(qint32(discovered.loadAcquire())));
+        }
+
+        ScanJob::Progress progress = scanner.progress();
+        if (progress.files != lastFiles) {
+            lastFiles = progress.files;
+            clientGone = clientGone
+                || !sendFrame(socket, Progress, pack(progress.files, progress.bytes,
+                                                     qint32(progress.discovered), progress.currentPath));
+        }
+
+        if (finished) {
+            break;
+        }
+
+        if (!clientGone && waitReadable(socket, 0)) {
+            Frame frame;
+            if (!receiveFrame(socket, frame)) {
+                clientGone = true;
+            } else if (frame.type == Cancel) {
+                scanner.requestInterruption();
+            }
+        }
+        if (clientGone || isInterruptionRequested()) {
+            scanner.requestInterruption();
+        }
+    }
+
+    if (!clientGone) {
+        sendFrame(socket, Done, pack(lastFiles, qint32(cacheHits.loadAcquire()),
+                                     qint32(cacheMisses.loadAcquire()),
+                                     qint32(duplicates.loadAcquire()),
+                                     qint32(errors.loadAcquire())));
+    }
+}
+
+QSharedPointer<ScanEngine> ScanSession::acquireEngine()
+{
+    QSharedPointer<ScanEngine> engine;
+    while (!engine && !isInterruptionRequested()) {
+        engine = engines->waitForEngine(nullptr, 100);
+    }
+    return engine;
+}
+
+void ScanSession::scanDescriptor(int fd, const QString& name)
+{
+    engines->beginScan();
+    QSharedPointer<ScanEngine> engine = acquireEngine();
+    QString threat;
+    bool completed = false;
+    bool infected = engine && engine->scanDescriptor(fd, name, threat, &completed);
+    engine.reset();
+    engines->endScan();
+
+    struct stat info;
+    qint64 size = (fstat(fd, &info) == 0) ? qint64(info.st_size) : 0;
+    ::close(fd);
+
+    finishOne(name, size, infected, completed, threat);
+}
+
+void ScanSession::scanStream(const QString& name)
+{
+    QByteArray contents;
+    bool tooLarge = false;
+
+    for (;;) {
+        Frame frame;
+        if (!receiveFrame(socket, frame)) {
+            return;
+        }
+        if (frame.type == Cancel) {
+            return;
+        }
+        if (frame.type == StreamEnd) {
+            break;
+        }
+        if (frame.type != StreamData) {
+            sendError("Expected stream data");
+            return;
+        }
+        // Keep reading to the end so the connection stays in step
+        if (contents.size() + frame.payload.size() > MaxStreamSize) {
+            tooLarge = true;
+            contents.clear();
+        }
+        if (!tooLarge) {
+            contents.append(frame.payload);
+        }
+    }
+
+    if (tooLarge) {
+        sendError(QString("%1 is larger than %2 bytes; pass a descriptor instead")
+                      .arg(name).arg(MaxStreamSize));
+        return;
+    }
+
+    engines->beginScan();
+    QSharedPointer<ScanEngine> engine = acquireEngine();
+    QString threat;
+    bool completed = false;
+    bool infected = engine && engine->scanData(contents, name, threat, &completed);
+    engine.reset();
+    engines->endScan();
+
+    finishOne(name, contents.size(), infected, completed, threat);
+}
+
+void ScanSession::finishOne(const QString& name, qint64 size, bool infected, bool completed,
+                            const QString& threat)
+{
+    if (infected) {
+        sendFrame(socket, Threat, pack(name, threat, size, QDateTime::currentMSecsSinceEpoch()));
+    } else if (!completed) {
+        sendError(QString("Could not scan %1").arg(name));
+        return;
+    }
+    sendFrame(socket, Done, pack(qint64(1), qint32(0), qint32(0), qint32(0), qint32(0)));
+}
+
+void ScanSession::sendError(const QString& message)
+{
+    sendFrame(socket, Error, pack(message));
+}
+
+ScanDaemon::ScanDaemon(EngineService *engines, QObject *parent)
+    : QObject(parent)
+    , engines(engines)
+    , listener(-1)
+    , notifier(nullptr)
+{
+}
+
+ScanDaemon::~ScanDaemon()
+{
+    for (const QPointer<ScanSession>& session : sessions) {
+        if (session) {
+            session->requestInterruption();
+        }
+    }
+    for (const QPointer<ScanSession>& session : sessions) {
+        if (session) {
+            session->wait();
+            delete session;
+        }
+    }
+
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(QFile::encodeName(socketPath).constData());
+    }
+}
+
+bool ScanDaemon::listen(const QString& path, QString& error)
+{
+    int running = connectToDaemon(path);
+    if (running >= 0) {
+        ::close(running);
+        error = QString("nehnes-scand is already running on %1").arg(path);
+        return false;
+    }
+
+    QByteArray name = QFile::encodeName(path);
+    struct sockaddr_un address = {};
+    if (size_t(name.size()) >= sizeof(address.sun_path)) {
+        error = QString("Socket path is too long: %1").arg(path);
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, name.constData(), size_t(name.size()));
+
+    // Nobody answered, so whatever is there is left over from a crash
+    ::unlink(name.constData());
+
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        error = QString("socket: %1").arg(strerror(errno));
+        return false;
+    }
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+
+    // Created owner-only from the start, not chmod'ed after the fact
+    mode_t mask = umask(0077);
+    int bound = ::bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+    umask(mask);
+    if (bound != 0 || ::listen(listener, 16) != 0) {
+        error = QString("Cannot listen on %1: %2").arg(path, strerror(errno));
+        ::close(listener);
+        listener = -1;
+        return false;
+    }
+
+    socketPath = path;
+    notifier = new QSocketNotifier(listener, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &ScanDaemon::acceptClient);
+    return true;
+}
+
+void ScanDaemon::acceptClient()
+{
+    int client = ::accept(listener, nullptr, nullptr);
+    if (client < 0) {
+        return;
+    }
+    fcntl(client, F_SETFD, FD_CLOEXEC);
+
+    if (!peerIsSameUser(client)) {
+        ::close(client);
+        return;
+    }
+
+    sessions.removeAll(QPointer<ScanSession>());
+    ScanSession *session = new ScanSession(client, engines, this);
+    connect(session, &QThread::finished, session, &QObject::deleteLater);
+    sessions.append(session);
+    session->start();
+}
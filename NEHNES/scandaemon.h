@@ -0,0 +1,65 @@
+#ifndef SCANDAEMON_H
+#define SCANDAEMON_H
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QThread>
+#include "engineservice.h"
+#include "scanprotocol.h"
+
+class QSocketNotifier;
+
+// One client connection of nehnes-scand. Serves its requests one after the
+// other on its own thread, streaming results back while each scan runs.
+class ScanSession : public QThread
+{
+    Q_OBJECT
+
+public:
+    ScanSession(int socket, EngineService *engines, QObject *parent = nullptr);
+    ~ScanSession();
+
+    void run() override;
+
+private:
+    int socket;
+    EngineService *engines;
+
+    void scanPaths(const QStringList& paths);
+    void scanDescriptor(int fd, const QString& name);
+    void scanStream(const QString& name);
+    // Waits for the shared engine, reloading it if it was evicted
+    QSharedPointer<ScanEngine> acquireEngine();
+    void finishOne(const QString& name, qint64 size, bool infected, bool completed,
+                   const QString& threat);
+    void sendError(const QString& message);
+};
+
+// The nehnes-scand server: owns the scan engine and accepts clients on a
+// Unix domain socket only the user running it can connect to. Every client
+// scans with the same engine, so it is loaded once per host instead of
+// once per process.
+class ScanDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScanDaemon(EngineService *engines, QObject *parent = nullptr);
+    ~ScanDaemon();
+
+    // Takes over a stale socket file, but not one a daemon still answers on
+    bool listen(const QString& path, QString& error);
+
+private slots:
+    void acceptClient();
+
+private:
+    EngineService *engines;
+    int listener;
+    QString socketPath;
+    QSocketNotifier *notifier;
+    QList<QPointer<ScanSession>> sessions;
+};
+
+#endif // SCANDAEMON_H
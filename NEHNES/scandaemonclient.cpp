@@ -0,0 +1,130 @@
+#include "scandaemonclient.h"
+#include "scanprotocol.h"
+#include <QFileInfo>
+
+ScanDaemonClient::ScanDaemonClient(const QStringList& pathsToScan, QObject *parent)
+    : ScanJob(parent)
+    , socket(-1)
+    , results(16384)
+{
+    // The daemon has its own working directory, so relative paths would
+    // name a different tree there
+    for (const QString& path : pathsToScan) {
+        paths.append(QFileInfo(path).absoluteFilePath());
+    }
+}
+
+ScanDaemonClient::~ScanDaemonClient()
+{
+    ScanProtocol::closeSocket(socket);
+}
+
+bool ScanDaemonClient::isAvailable()
+{
+    int probe = ScanProtocol::connectToDaemon();
+    ScanProtocol::closeSocket(probe);
+    return probe >= 0;
+}
+
+bool ScanDaemonClient::connectToDaemon()
+{
+    if (socket < 0) {
+        socket = ScanProtocol::connectToDaemon();
+    }
+    return socket >= 0;
+}
+
+ScanJob::Progress ScanDaemonClient::progress() const
+{
+    QMutexLocker locker(&progressMutex);
+    return latest;
+}
+
+int ScanDaemonClient::takeResults(QVector<Result>& out, int max)
+{
+    return results.drain(out, max);
+}
+
+void ScanDaemonClient::run()
+{
+    if (!ScanProtocol::sendFrame(socket, ScanProtocol::ScanPaths, ScanProtocol::pack(paths))) {
+        emit scanFailed("Could not send the scan request to nehnes-scand");
+        emit scanComplete();
+        return;
+    }
+
+    bool cancelSent = false;
+    bool done = false;
+    while (!done) {
+        // The daemon answers a cancel with Done, like any other scan
+        if (isInterruptionRequested() && !cancelSent) {
+            cancelSent = true;
+            ScanProtocol::sendFrame(socket, ScanProtocol::Cancel);
+        }
+        if (!ScanProtocol::waitReadable(socket, 100)) {
+            continue;
+        }
+
+        ScanProtocol::Frame frame;
+        if (!ScanProtocol::receiveFrame(socket, frame)) {
+            emit scanFailed("nehnes-scand closed the connection before the scan finished");
+            break;
+        }
+
+        switch (frame.type) {
+        case ScanProtocol::Progress: {
+            Progress progress;
+            qint32 discovered = 0;
+            if (ScanProtocol::unpack(frame.payload, progress.files, progress.bytes,
+                                     discovered, progress.currentPath)) {
+                progress.discovered = discovered;
+                QMutexLocker locker(&progressMutex);
+                latest = progress;
+            }
+            break;
+        }
+        case ScanProtocol::Threat: {
+            Result result;
+            if (ScanProtocol::unpack(frame.payload, result.path, result.threatName,
+                                     result.size, result.detectedAt)) {
+                // Blocks while the UI is behind, which in turn holds up the daemon
+                results.push(std::move(result), [this] { return isInterruptionRequested(); });
+            }
+            break;
+        }
+        case ScanProtocol::Discovered: {
+            qint32 total = 0;
+            if (ScanProtocol::unpack(frame.payload, total)) {
+                emit discoveryComplete(total);
+            }
+            break;
+        }
+        case ScanProtocol::Done: {
+            qint64 files = 0;
+            qint32 hits = 0;
+            qint32 misses = 0;
+            qint32 duplicates = 0;
+            qint32 errors = 0;
+            ScanProtocol::unpack(frame.payload, files, hits, misses, duplicates, errors);
+            emit verdictCacheStats(hits, misses);
+            emit duplicatesSkipped(duplicates);
+            emit scanErrors(errors);
+            done = true;
+            break;
+        }
+        case ScanProtocol::Error: {
+            QString message;
+            ScanProtocol::unpack(frame.payload, message);
+            emit scanFailed(message);
+            done = true;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    ScanProtocol::closeSocket(socket);
+    socket = -1;
+    emit scanComplete();
+}
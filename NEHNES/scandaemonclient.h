@@ -0,0 +1,42 @@
+#ifndef SCANDAEMONCLIENT_H
+#define SCANDAEMONCLIENT_H
+
+#include <QMutex>
+#include <QStringList>
+#include "resultring.h"
+#include "scanjob.h"
+
+// Runs a scan in nehnes-scand instead of this process: sends the paths and
+// turns the frames that come back into the usual progress and results, so
+// the window needs no engine of its own. Relative paths are resolved here,
+// against the caller's working directory.
+class ScanDaemonClient : public ScanJob
+{
+    Q_OBJECT
+
+public:
+    explicit ScanDaemonClient(const QStringList& pathsToScan, QObject *parent = nullptr);
+    ~ScanDaemonClient();
+
+    // Whether a daemon is answering on the socket right now
+    static bool isAvailable();
+
+    // Call before start(); false means no daemon, scan in-process instead
+    bool connectToDaemon();
+
+    Progress progress() const override;
+    int takeResults(QVector<Result>& out, int max = 4096) override;
+
+    void run() override;
+
+private:
+    QStringList paths;
+    int socket;
+
+    mutable QMutex progressMutex;
+    Progress latest;
+
+    ResultRing<Result> results;
+};
+
+#endif // SCANDAEMONCLIENT_H
@@ -0,0 +1,351 @@
+#include "scanengine.h"
+#include "scanfilehandle.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+ScanEngine::ScanEngine()
+    : clam(nullptr)
+    , databaseVersion(0)
+    , signatures(0)
+    , loadedProfile(Full)
+    , loadMs(0)
+    , compileMs(0)
+    , residentCost(-1)
+{
+}
+
+ScanEngine::~ScanEngine()
+{
+    if (clam) {
+        cl_engine_free(clam);
+    }
+}
+
+QString ScanEngine::profileName(Profile profile)
+{
+    switch (profile) {
+    case Balanced:
+        return "balanced";
+    case Lite:
+        return "lite";
+    case Full:
+        break;
+    }
+    return "full";
+}
+
+ScanEngine::Profile ScanEngine::profileFromName(const QString& name)
+{
+    if (name == "balanced") {
+        return Balanced;
+    }
+    if (name == "lite") {
+        return Lite;
+    }
+    return Full;
+}
+
+qint64 ScanEngine::residentMemory()
+{
+#ifdef Q_OS_LINUX
+    // Second field of statm is the resident set, in pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+QSharedPointer<ScanEngine> ScanEngine::loadClamAV(const QString& databasePath, Profile profile,
+                                                  QString& error)
+{
+    QSharedPointer<ScanEngine> engine(new ScanEngine);
+    engine->dbPath = databasePath;
+    engine->loadedProfile = profile;
+
+    qint64 residentBefore = residentMemory();
+
+    engine->clam = cl_engine_new();
+    if (!engine->clam) {
+        error = "Failed to create ClamAV engine";
+        return QSharedPointer<ScanEngine>();
+    }
+
+    // Phishing and URL signatures are a large share of daily and only
+    // matter for mail; bytecode signatures need the bytecode runtime
+    unsigned int options = CL_DB_STDOPT;
+    if (profile == Balanced) {
+        options &= ~(CL_DB_PHISHING | CL_DB_PHISHING_URLS);
+    } else if (profile == Lite) {
+        options &= ~(CL_DB_PHISHING | CL_DB_PHISHING_URLS | CL_DB_BYTECODE);
+    }
+
+    // The full and balanced profiles load the whole directory in one go.
+    // Lite picks files one by one and leaves out main (the bulk of the
+    // memory) and bytecode.
+    QStringList files;
+    if (profile == Lite) {
+        // Same extensions cl_load() picks up when given the directory
+        const QStringList databaseFiles = {
+            "*.cvd", "*.cld", "*.cud", "*.hdb", "*.hsb", "*.hdu", "*.hsu", "*.mdb", "*.msb",
+            "*.mdu", "*.msu", "*.ndb", "*.ndu", "*.ldb", "*.ldu", "*.idb", "*.sdb", "*.cdb",
+            "*.crb", "*.cat", "*.fp", "*.sfp", "*.ign", "*.ign2", "*.ftm", "*.cfg",
+            "*.yar", "*.yara", "*.pwdb", "*.imp"
+        };
+        const QFileInfoList entries = QDir(databasePath).entryInfoList(databaseFiles, QDir::Files, QDir::Name);
+        for (const QFileInfo& entry : entries) {
+            QString base = entry.completeBaseName();
+            if (base == "main" || base == "bytecode") {
+                continue;
+            }
+            files.append(entry.filePath());
+        }
+    } else {
+        files.append(databasePath);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Load the virus database
+    for (const QString& file : files) {
+        cl_error_t ret = cl_load(QFile::encodeName(file).constData(), engine->clam,
+                                 &engine->signatures, options);
+        if (ret != CL_SUCCESS) {
+            error = QString("Failed to load virus database: %1").arg(cl_strerror(ret));
+            return QSharedPointer<ScanEngine>();
+        }
+    }
+
+    engine->loadMs = timer.restart();
+
+    // Compile the engine
+    cl_error_t ret = cl_engine_compile(engine->clam);
+    engine->compileMs = timer.elapsed();
+    if (ret != CL_SUCCESS) {
+        error = QString("Failed to compile engine: %1").arg(cl_strerror(ret));
+        return QSharedPointer<ScanEngine>();
+    }
+
+    qint64 residentAfter = residentMemory();
+    if (residentBefore >= 0 && residentAfter >= 0) {
+        engine->residentCost = qMax<qint64>(0, residentAfter - residentBefore);
+    }
+
+    // Cached clean verdicts are only valid for the database (and the part
+    // of it) they came from
+    int err = 0;
+    quint64 dbVersion = quint64(cl_engine_get_num(engine->clam, CL_ENGINE_DB_VERSION, &err));
+    quint64 dbTime = quint64(cl_engine_get_num(engine->clam, CL_ENGINE_DB_TIME, &err));
+    engine->databaseVersion = (dbVersion << 32) ^ dbTime ^ engine->signatures
+                              ^ qHash(QString(cl_retver())) ^ (quint64(profile) << 60);
+
+    return engine;
+}
+
+QSharedPointer<ScanEngine> ScanEngine::builtIn(const QMap<QString, QString>& signatures)
+{
+    QSharedPointer<ScanEngine> engine(new ScanEngine);
+
+    // Compiled once here instead of for every scan or file
+    for (auto it = signatures.constBegin(); it != signatures.constEnd(); ++it) {
+        engine->builtInMatcher.addSignature(it.key(), it.value().toUtf8());
+        engine->databaseVersion = engine->databaseVersion * 31 + qHash(it.key()) + qHash(it.value());
+    }
+    engine->builtInMatcher.compile();
+    engine->signatures = unsigned(signatures.size());
+
+    return engine;
+}
+
+struct cl_engine *ScanEngine::clamEngine() const
+{
+    return clam;
+}
+
+const SignatureMatcher& ScanEngine::matcher() const
+{
+    return builtInMatcher;
+}
+
+quint64 ScanEngine::version() const
+{
+    return databaseVersion;
+}
+
+unsigned int ScanEngine::signatureCount() const
+{
+    return signatures;
+}
+
+QString ScanEngine::databasePath() const
+{
+    return dbPath;
+}
+
+ScanEngine::Profile ScanEngine::profile() const
+{
+    return loadedProfile;
+}
+
+qint64 ScanEngine::loadTime() const
+{
+    return loadMs;
+}
+
+qint64 ScanEngine::compileTime() const
+{
+    return compileMs;
+}
+
+qint64 ScanEngine::residentBytes() const
+{
+    return residentCost;
+}
+
+bool ScanEngine::scanFile(const QString& path, QString& threat, bool *completed, qint64 chunkSize) const
+{
+    // Open the file ourselves so the scan does not touch atime and the
+    // kernel knows it is a single sequential pass
+    ScanFileHandle handle(path);
+    if (handle.open()) {
+        return scanDescriptor(handle.descriptor(), path, threat, completed, chunkSize);
+    }
+
+    *completed = false;
+
+    if (!clam) {
+        FileChunkReader reader(path, chunkSize);
+        return scanChunks(reader, threat, completed);
+    }
+
+    const char *virname = nullptr;
+    unsigned long int scanned = 0;
+    struct cl_scan_options options = {};
+    options.general = CL_SCAN_GENERAL_ALLMATCHES;
+    options.parse = ~0u;
+    QByteArray name = QFile::encodeName(path);
+    cl_error_t ret = cl_scanfile(name.constData(), &virname, &scanned, clam, &options);
+    if (ret == CL_VIRUS) {
+        threat = QString::fromUtf8(virname);
+        return true;
+    }
+    *completed = (ret == CL_CLEAN);
+    return false;
+}
+
+bool ScanEngine::scanDescriptor(int fd, const QString& name, QString& threat, bool *completed,
+                                qint64 chunkSize) const
+{
+    *completed = false;
+
+    if (!clam) {
+        FileChunkReader reader(fd, chunkSize);
+        return scanChunks(reader, threat, completed);
+    }
+
+    const char *virname = nullptr;
+    unsigned long int scanned = 0;
+    struct cl_scan_options options = {};
+    options.general = CL_SCAN_GENERAL_ALLMATCHES;
+    options.parse = ~0u;
+    QByteArray label = name.toUtf8();
+    cl_error_t ret = cl_scandesc(fd, label.constData(), &virname, &scanned, clam, &options);
+    if (ret == CL_VIRUS) {
+        threat = QString::fromUtf8(virname);
+        return true;
+    }
+    *completed = (ret == CL_CLEAN);
+    return false;
+}
+
+bool ScanEngine::scanData(const QByteArray& data, const QString& name, QString& threat, bool *completed) const
+{
+    *completed = false;
+
+    if (!clam) {
+        SignatureMatcher::Stream stream(builtInMatcher);
+        QVector<SignatureMatcher::Match> matches;
+        stream.feed(reinterpret_cast<const uchar*>(data.constData()), data.size(), matches);
+        *completed = true;
+        if (matches.isEmpty()) {
+            return false;
+        }
+        threat = builtInMatcher.signatureName(matches.first().signature);
+        return true;
+    }
+
+    // Nothing to match, and a zero-length fmap is not something to count on
+    if (data.isEmpty()) {
+        *completed = true;
+        return false;
+    }
+
+    // The bytes are already in memory; hand them to libclamav through an
+    // in-memory fmap so the scan only costs CPU time
+    cl_fmap_t *map = cl_fmap_open_memory(data.constData(), size_t(data.size()));
+    if (!map) {
+        return false;
+    }
+    const char *virname = nullptr;
+    unsigned long int scanned = 0;
+    struct cl_scan_options options = {};
+    options.general = CL_SCAN_GENERAL_ALLMATCHES;
+    options.parse = ~0u;
+    QByteArray label = name.toUtf8();
+    cl_error_t ret = cl_scanmap_callback(map, label.constData(), &virname, &scanned,
+                                         clam, &options, nullptr);
+    cl_fmap_close(map);
+
+    if (ret == CL_VIRUS) {
+        threat = QString::fromUtf8(virname);
+        return true;
+    }
+    *completed = (ret == CL_CLEAN);
+    return false;
+}
+
+bool ScanEngine::scanChunks(FileChunkReader& reader, QString& threat, bool *completed) const
+{
+    // The file is fed to the matcher one chunk at a time, so memory use is
+    // bounded by the chunk size whatever the file (or pipe) holds
+    if (!reader.open()) {
+        return false;
+    }
+
+    SignatureMatcher::Stream stream(builtInMatcher);
+    QVector<SignatureMatcher::Match> matches;
+
+    const uchar *data = nullptr;
+    qint64 length = 0;
+    qint64 offset = 0;
+    while (matches.isEmpty() && reader.next(data, length, offset)) {
+        // Sparse holes read as zeros without being read at all
+        if (offset > stream.position()) {
+            stream.skipZeros(offset - stream.position(), matches);
+        }
+        if (matches.isEmpty()) {
+            stream.feed(data, length, matches);
+        }
+    }
+    if (matches.isEmpty() && !reader.hasError() && reader.size() > stream.position()) {
+        stream.skipZeros(reader.size() - stream.position(), matches);
+    }
+
+    if (!matches.isEmpty()) {
+        threat = builtInMatcher.signatureName(matches.first().signature);
+        return true;
+    }
+    *completed = !reader.hasError();
+    return false;
+}
@@ -0,0 +1,87 @@
+#ifndef SCANENGINE_H
+#define SCANENGINE_H
+
+#include <QMap>
+#include <QSharedPointer>
+#include <QString>
+#include <clamav.h>
+#include "filechunkreader.h"
+#include "signaturematcher.h"
+
+// One loaded set of signatures: a compiled ClamAV engine, or the built-in
+// patterns when ClamAV is not available. Nothing changes after it has been
+// built, so any number of scans can share one instance; the ClamAV engine
+// is freed together with the last reference.
+class ScanEngine
+{
+public:
+    // How much of the ClamAV database to load. Smaller profiles trade
+    // detection coverage for memory and load time on small machines.
+    enum Profile {
+        Full,     // every database, bytecode and phishing signatures
+        Balanced, // every database, no phishing/URL signatures
+        Lite      // daily and custom databases only; no main.cvd, bytecode or phishing
+    };
+
+    static QString profileName(Profile profile);
+    static Profile profileFromName(const QString& name);
+
+    ~ScanEngine();
+
+    // Loads and compiles the databases under databasePath that profile
+    // asks for. Returns null and sets error on failure.
+    static QSharedPointer<ScanEngine> loadClamAV(const QString& databasePath, Profile profile,
+                                                 QString& error);
+    // Built-in pattern matcher only (name -> pattern)
+    static QSharedPointer<ScanEngine> builtIn(const QMap<QString, QString>& signatures);
+
+    // Null for the built-in engine
+    struct cl_engine *clamEngine() const;
+    const SignatureMatcher& matcher() const;
+
+    // Identifies the signature set; cached verdicts from another version
+    // are not trusted
+    quint64 version() const;
+    unsigned int signatureCount() const;
+    QString databasePath() const;
+
+    Profile profile() const;
+
+    // How long cl_load() and cl_engine_compile() took, in milliseconds
+    qint64 loadTime() const;
+    qint64 compileTime() const;
+    // Growth of the process's resident memory while loading, or -1 where
+    // the platform does not tell us
+    qint64 residentBytes() const;
+
+    // Scans a file, an open descriptor or bytes in memory with ClamAV, or
+    // with the built-in matcher when there is no ClamAV engine. name only
+    // labels the scan. Returns true on a detection; completed is set when a
+    // clean verdict could be reached, so unreadable files are never
+    // mistaken for clean ones. Without ClamAV, files are read chunkSize
+    // bytes at a time.
+    bool scanFile(const QString& path, QString& threat, bool *completed,
+                  qint64 chunkSize = FileChunkReader::defaultChunkSize()) const;
+    bool scanDescriptor(int fd, const QString& name, QString& threat, bool *completed,
+                        qint64 chunkSize = FileChunkReader::defaultChunkSize()) const;
+    bool scanData(const QByteArray& data, const QString& name, QString& threat, bool *completed) const;
+
+private:
+    ScanEngine();
+    Q_DISABLE_COPY(ScanEngine)
+
+    struct cl_engine *clam;
+    SignatureMatcher builtInMatcher;
+    quint64 databaseVersion;
+    unsigned int signatures;
+    QString dbPath;
+    Profile loadedProfile;
+    qint64 loadMs;
+    qint64 compileMs;
+    qint64 residentCost;
+
+    static qint64 residentMemory();
+    bool scanChunks(FileChunkReader& reader, QString& threat, bool *completed) const;
+};
+
+#endif // SCANENGINE_H
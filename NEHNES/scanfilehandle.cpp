@@ -0,0 +1,168 @@
+#include "scanfilehandle.h"
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <QAtomicInt>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+// Residency is sampled over the start of the file only; that is enough to
+// tell a file somebody is using from one nobody has read in a while
+const qint64 ResidencyProbeBytes = 4 * 1024 * 1024;
+
+// cachestat() came with Linux 6.5; the number is the same on every
+// architecture, but older headers do not have it or its structs
+#ifndef __NR_cachestat
+#define __NR_cachestat 451
+#endif
+
+struct CachestatRange
+{
+    quint64 offset;
+    quint64 length;
+};
+
+struct Cachestat
+{
+    quint64 cached;
+    quint64 dirty;
+    quint64 writeback;
+    quint64 evicted;
+    quint64 recentlyEvicted;
+};
+
+// Cleared the first time the kernel says it has no cachestat() (before 6.5)
+QAtomicInt haveCachestat(1);
+#endif
+
+}
+
+ScanFileHandle::ScanFileHandle(const QString& path)
+    : path(path)
+    , fd(-1)
+    , fileSize(0)
+    , wasCached(false)
+{
+}
+
+ScanFileHandle::~ScanFileHandle()
+{
+    close();
+}
+
+bool ScanFileHandle::open()
+{
+#ifdef Q_OS_UNIX
+    const QByteArray name = QFile::encodeName(path);
+    int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_NOATIME
+    flags |= O_NOATIME;
+#endif
+
+    do {
+        fd = ::open(name.constData(), flags);
+#ifdef O_NOATIME
+        // O_NOATIME is only allowed on files we own (or with CAP_FOWNER)
+        if (fd < 0 && errno == EPERM && (flags & O_NOATIME)) {
+            flags &= ~O_NOATIME;
+            errno = EINTR;
+        }
+#endif
+    } while (fd < 0 && errno == EINTR);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        fileSize = info.st_size;
+        wasCached = checkCached();
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ScanFileHandle::close()
+{
+#ifdef Q_OS_UNIX
+    if (fd < 0) {
+        return;
+    }
+
+#ifdef POSIX_FADV_DONTNEED
+    // Give back the page cache this scan filled, but leave files other
+    // programs were already using alone
+    if (fileSize > 0 && !wasCached) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+#endif
+
+    ::close(fd);
+    fd = -1;
+#endif
+}
+
+bool ScanFileHandle::isOpen() const
+{
+    return fd >= 0;
+}
+
+int ScanFileHandle::descriptor() const
+{
+    return fd;
+}
+
+bool ScanFileHandle::checkCached() const
+{
+    // Runs for every file we open, so it has to stay one cheap syscall:
+    // no mapping, whose munmap would cost a TLB shootdown on every core
+    // running a worker
+#ifdef Q_OS_LINUX
+    if (fileSize <= 0) {
+        return false;
+    }
+
+    if (haveCachestat.loadRelaxed()) {
+        CachestatRange range = { 0, quint64(qMin(fileSize, ResidencyProbeBytes)) };
+        Cachestat stat = {};
+        if (::syscall(__NR_cachestat, fd, &range, &stat, 0) == 0) {
+            return stat.cached > 0;
+        }
+        if (errno == ENOSYS) {
+            haveCachestat.storeRelaxed(0);
+        }
+    }
+
+#ifdef RWF_NOWAIT
+    // Reading the first byte without waiting fails with EAGAIN unless its
+    // page is already in the cache
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    if (::preadv2(fd, &iov, 1, 0, RWF_NOWAIT) >= 0) {
+        return true;
+    }
+    if (errno == EAGAIN) {
+        return false;
+    }
+#endif
+#endif
+    // Cannot tell, so do not risk evicting somebody else's pages
+    return true;
+}
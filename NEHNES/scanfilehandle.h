@@ -0,0 +1,37 @@
+#ifndef SCANFILEHANDLE_H
+#define SCANFILEHANDLE_H
+
+#include <QString>
+
+// Read-only descriptor for a file about to be scanned.
+//
+// Opened with O_NOATIME (when we are allowed to) and O_CLOEXEC, and with
+// readahead hints for one sequential pass. When the handle goes away, pages
+// the scan pulled into the page cache are dropped again, unless the file
+// was already cached before we touched it, so a full scan does not push
+// the working set of other programs out of memory.
+//
+// On platforms without POSIX descriptors open() fails and callers scan by
+// path instead.
+class ScanFileHandle
+{
+public:
+    explicit ScanFileHandle(const QString& path);
+    ~ScanFileHandle();
+
+    bool open();
+    void close();
+
+    bool isOpen() const;
+    int descriptor() const;
+
+private:
+    QString path;
+    int fd;
+    qint64 fileSize;
+    bool wasCached;
+
+    bool checkCached() const;
+};
+
+#endif // SCANFILEHANDLE_H
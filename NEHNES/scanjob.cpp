@@ -0,0 +1,33 @@
+#include "scanjob.h"
+#include "antivirusscanner.h"
+#include "engineservice.h"
+#include "scandaemonclient.h"
+
+ScanJob *submitScan(const QStringList& paths, EngineService *engines,
+                    const ScanOptions& options, QObject *parent)
+{
+    if (options.preferDaemon) {
+        ScanDaemonClient *client = new ScanDaemonClient(paths, parent);
+        if (client->connectToDaemon()) {
+            return client;
+        }
+        delete client;
+    }
+
+    if (engines->state() == EngineService::NotLoaded) {
+        engines->startLoading();
+    }
+
+    AntivirusScanner *scanner = new AntivirusScanner(paths, engines, parent);
+    if (options.threads > 0) {
+        scanner->setThreadCount(options.threads);
+    }
+    if (options.readers > 0) {
+        scanner->setReaderThreadCount(options.readers);
+    }
+    scanner->setWalkerMethod(options.walker);
+    if (options.walkerThreads > 0) {
+        scanner->setWalkerThreadCount(options.walkerThreads);
+    }
+    return scanner;
+}
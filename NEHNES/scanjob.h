@@ -0,0 +1,75 @@
+#ifndef SCANJOB_H
+#define SCANJOB_H
+
+#include <QThread>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "directorywalker.h"
+
+class EngineService;
+
+// A scan running on its own thread, as the UI sees it: progress counters it
+// samples on a timer and a batch of detections it collects in between. The
+// scan either runs in this process (AntivirusScanner) or in nehnes-scand
+// (ScanDaemonClient); the dialog does not care which.
+class ScanJob : public QThread
+{
+    Q_OBJECT
+
+public:
+    using QThread::QThread;
+
+    // Snapshot of a running scan. Workers only bump counters, the UI polls
+    // this on a timer, so progress reporting costs nothing per file.
+    struct Progress
+    {
+        qint64 files = 0;
+        qint64 bytes = 0;
+        int discovered = 0;
+        QString currentPath;
+    };
+    virtual Progress progress() const = 0;
+
+    // One detection
+    struct Result
+    {
+        QString path;
+        QString threatName;
+        qint64 size = 0;
+        qint64 detectedAt = 0; // ms since epoch
+    };
+
+    // Moves up to max pending detections into out. Must always be called
+    // from the same thread.
+    virtual int takeResults(QVector<Result>& out, int max = 4096) = 0;
+
+signals:
+    void discoveryComplete(int total);
+    void verdictCacheStats(int hits, int misses);
+    void duplicatesSkipped(int count);
+    // Files that could not be scanned plus directories that could not be listed
+    void scanErrors(int count);
+    // The scan could not be carried out (or only partly); the message says why
+    void scanFailed(const QString& message);
+    void scanComplete();
+};
+
+// How submitScan() runs a scan. Zero counts keep the scanner's defaults.
+struct ScanOptions
+{
+    int threads = 0;
+    int readers = 0;
+    DirectoryWalker::Method walker = DirectoryWalker::defaultMethod();
+    int walkerThreads = 0;
+    // Scan in nehnes-scand when it is running, so no engine is loaded here
+    bool preferDaemon = true;
+};
+
+// Entry point of the scan core for every front end: sets up a scan of
+// paths, in the daemon or in this process with engines (loading the engine
+// if nobody has yet). The job is not started; the caller owns it.
+ScanJob *submitScan(const QStringList& paths, EngineService *engines,
+                    const ScanOptions& options = ScanOptions(), QObject *parent = nullptr);
+
+#endif // SCANJOB_H
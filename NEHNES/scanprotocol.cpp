@@ -0,0 +1,254 @@
+#include "scanprotocol.h"
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace ScanProtocol {
+
+namespace {
+
+const int HeaderSize = 5;
+
+#ifdef Q_OS_UNIX
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+bool sendAll(int socket, const char *data, qint64 length)
+{
+    while (length > 0) {
+        ssize_t sent = ::send(socket, data, size_t(length), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Collects any descriptors riding on this read; all but the first are closed
+void takeDescriptors(struct msghdr& message, int *passedFd)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        int count = int((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        const unsigned char *data = CMSG_DATA(cmsg);
+        for (int i = 0; i < count; ++i) {
+            int fd;
+            memcpy(&fd, data + i * sizeof(int), sizeof(int));
+            if (passedFd && *passedFd == -1) {
+                *passedFd = fd;
+            } else {
+                ::close(fd);
+            }
+        }
+    }
+}
+
+bool receiveAll(int socket, char *data, qint64 length, int *passedFd)
+{
+    while (length > 0) {
+        struct iovec iov = { data, size_t(length) };
+        union {
+            struct cmsghdr align;
+            char buffer[CMSG_SPACE(sizeof(int) * 4)];
+        } control;
+        struct msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+        ssize_t received = ::recvmsg(socket, &message, flags);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        takeDescriptors(message, passedFd);
+        data += received;
+        length -= received;
+    }
+    return true;
+}
+#endif
+
+}
+
+QString socketPath()
+{
+    QString path = qEnvironmentVariable("NEHNES_SCAND_SOCKET");
+    if (!path.isEmpty()) {
+        return path;
+    }
+    QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (runtime.isEmpty()) {
+        runtime = QDir::tempPath();
+    }
+    return runtime + "/nehnes-scand.sock";
+}
+
+#ifdef Q_OS_UNIX
+
+int connectToDaemon(const QString& path)
+{
+    QByteArray name = QFile::encodeName(path);
+    struct sockaddr_un address = {};
+    if (size_t(name.size()) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, name.constData(), size_t(name.size()));
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+#ifdef SO_NOSIGPIPE
+    // No MSG_NOSIGNAL here; a daemon going away must not kill the client
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    return fd;
+}
+
+void closeSocket(int socket)
+{
+    if (socket >= 0) {
+        ::close(socket);
+    }
+}
+
+bool sendFrame(int socket, quint8 type, const QByteArray& payload, int passFd)
+{
+    if (quint32(payload.size()) + 1 > MaxFrameSize) {
+        return false;
+    }
+
+    char header[HeaderSize];
+    qToBigEndian<quint32>(quint32(payload.size() + 1), header);
+    header[4] = char(type);
+
+    if (passFd < 0) {
+        return sendAll(socket, header, HeaderSize) && sendAll(socket, payload.constData(), payload.size());
+    }
+
+    // The descriptor rides on the header bytes
+    struct iovec iov = { header, HeaderSize };
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &passFd, sizeof(int));
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent <= 0) {
+        return false;
+    }
+    return sendAll(socket, header + sent, HeaderSize - sent)
+        && sendAll(socket, payload.constData(), payload.size());
+}
+
+bool receiveFrame(int socket, Frame& frame, int *passedFd)
+{
+    if (passedFd) {
+        *passedFd = -1;
+    }
+
+    char header[HeaderSize];
+    if (!receiveAll(socket, header, HeaderSize, passedFd)) {
+        return false;
+    }
+    quint32 length = qFromBigEndian<quint32>(header);
+    if (length < 1 || length > MaxFrameSize) {
+        return false;
+    }
+
+    frame.type = quint8(header[4]);
+    frame.payload.resize(int(length - 1));
+    return receiveAll(socket, frame.payload.data(), frame.payload.size(), passedFd);
+}
+
+bool waitReadable(int socket, int timeoutMs)
+{
+    struct pollfd pfd = { socket, POLLIN, 0 };
+    int ready;
+    do {
+        ready = ::poll(&pfd, 1, timeoutMs);
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0;
+}
+
+#else
+
+// The daemon is Unix only; clients elsewhere always scan in-process
+
+int connectToDaemon(const QString&)
+{
+    return -1;
+}
+
+void closeSocket(int)
+{
+}
+
+bool sendFrame(int, quint8, const QByteArray&, int)
+{
+    return false;
+}
+
+bool receiveFrame(int, Frame&, int *)
+{
+    return false;
+}
+
+bool waitReadable(int, int)
+{
+    return false;
+}
+
+#endif
+
+}
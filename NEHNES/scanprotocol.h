@@ -0,0 +1,89 @@
+#ifndef SCANPROTOCOL_H
+#define SCANPROTOCOL_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QIODevice>
+#include <QString>
+
+// Wire format between nehnes-scand and its clients, over a Unix domain
+// stream socket. Every message is a frame:
+//
+//     quint32 length (big endian, covers type + payload)
+//     quint8  type
+//     payload (QDataStream fields, or raw bytes for StreamData)
+//
+// A client sends one request (ScanPaths, ScanDescriptor, or StreamBegin /
+// StreamData... / StreamEnd) and reads frames until Done or Error. While a
+// scan runs the daemon streams Threat and Progress frames; Cancel stops it.
+namespace ScanProtocol {
+
+enum MessageType : quint8 {
+    // Client to daemon
+    ScanPaths = 1,      // QStringList paths; absolute, files and directories
+    ScanDescriptor = 2, // QString name; one descriptor attached with SCM_RIGHTS
+    StreamBegin = 3,    // QString name
+    StreamData = 4,     // raw bytes, any number of frames
+    StreamEnd = 5,      // empty
+    Cancel = 6,         // empty
+
+    // Daemon to client
+    Progress = 64,   // qint64 files, qint64 bytes, qint32 discovered, QString currentPath
+    Threat = 65,     // QString path, QString threatName, qint64 size, qint64 detectedAt
+    Discovered = 66, // qint32 total
+    Done = 67,       // qint64 files, qint32 cacheHits, qint32 cacheMisses, qint32 duplicates, qint32 errors
+    Error = 68       // QString message
+};
+
+// Larger frames are a protocol error; StreamData senders split their bytes
+const quint32 MaxFrameSize = 16 * 1024 * 1024;
+// Streamed contents are scanned from memory, so they are capped
+const qint64 MaxStreamSize = 512LL * 1024 * 1024;
+
+struct Frame
+{
+    quint8 type = 0;
+    QByteArray payload;
+};
+
+// $NEHNES_SCAND_SOCKET, else nehnes-scand.sock in the user's runtime directory
+QString socketPath();
+
+// Connects to the daemon; -1 if it is not running
+int connectToDaemon(const QString& path = socketPath());
+
+void closeSocket(int socket);
+
+// Blocking; passFd, if not -1, travels with the frame as SCM_RIGHTS
+bool sendFrame(int socket, quint8 type, const QByteArray& payload = QByteArray(), int passFd = -1);
+
+// Blocking read of the next frame. A descriptor that came with it is stored
+// in *passedFd (or closed if passedFd is null); -1 otherwise.
+bool receiveFrame(int socket, Frame& frame, int *passedFd = nullptr);
+
+// Waits up to timeoutMs for the socket to become readable. Hang-ups and
+// errors count as readable, so the following receiveFrame() reports them.
+bool waitReadable(int socket, int timeoutMs);
+
+template <typename... Args>
+QByteArray pack(const Args&... args)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    (stream << ... << args);
+    return payload;
+}
+
+template <typename... Args>
+bool unpack(const QByteArray& payload, Args&... args)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_15);
+    (stream >> ... >> args);
+    return stream.status() == QDataStream::Ok;
+}
+
+}
+
+#endif // SCANPROTOCOL_H
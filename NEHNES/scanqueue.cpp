@@ -0,0 +1,170 @@
+#include "scanqueue.h"
+#include <algorithm>
+
+ScanQueue::ScanQueue(int workers, int capacity)
+    : capacity(capacity)
+    , discoveredCount(0)
+    , closed(false)
+    , aborted(false)
+{
+    for (int i = 0; i < qMax(1, workers); ++i) {
+        deques.push_back(std::make_unique<WorkerDeque>());
+    }
+}
+
+bool ScanQueue::push(QVector<ScanItem> batch)
+{
+    {
+        QMutexLocker locker(&stateMutex);
+        while (queued.loadAcquire() >= capacity && !aborted) {
+            notFull.wait(&stateMutex);
+        }
+        if (aborted) {
+            return false;
+        }
+    }
+
+    std::sort(batch.begin(), batch.end(), [](const ScanItem& a, const ScanItem& b) {
+        return a.size > b.size;
+    });
+
+    // Deal the batch largest-first onto whichever deque has the least work
+    std::vector<qint64> load(deques.size());
+    for (size_t i = 0; i < deques.size(); ++i) {
+        QMutexLocker locker(&deques[i]->mutex);
+        load[i] = deques[i]->queuedBytes + qint64(deques[i]->items.size());
+    }
+
+    std::vector<std::vector<ScanItem>> dealt(deques.size());
+    for (ScanItem& item : batch) {
+        size_t target = std::min_element(load.begin(), load.end()) - load.begin();
+        load[target] += item.size + 1;
+        dealt[target].push_back(std::move(item));
+    }
+
+    for (size_t i = 0; i < deques.size(); ++i) {
+        if (dealt[i].empty()) {
+            continue;
+        }
+        WorkerDeque& d = *deques[i];
+        QMutexLocker locker(&d.mutex);
+        for (ScanItem& item : dealt[i]) {
+            auto pos = std::upper_bound(d.items.begin(), d.items.end(), item,
+                                        [](const ScanItem& a, const ScanItem& b) {
+                                            return a.size > b.size;
+                                        });
+            d.queuedBytes += item.size;
+            d.items.insert(pos, std::move(item));
+        }
+        // Counted before the deque is unlocked, so a thief can never take
+        // an item that queued does not include yet
+        queued.fetchAndAddRelease(int(dealt[i].size()));
+    }
+
+    QMutexLocker locker(&stateMutex);
+    discoveredCount += batch.size();
+    notEmpty.wakeAll();
+    return true;
+}
+
+bool ScanQueue::pop(int worker, ScanItem& item)
+{
+    forever {
+        if (takeOwn(worker, item) || steal(worker, item)) {
+            return true;
+        }
+
+        QMutexLocker locker(&stateMutex);
+        while (queued.loadAcquire() == 0 && !closed && !aborted) {
+            notEmpty.wait(&stateMutex);
+        }
+        if (aborted || (closed && queued.loadAcquire() == 0)) {
+            return false;
+        }
+    }
+}
+
+bool ScanQueue::takeOwn(int worker, ScanItem& item)
+{
+    WorkerDeque& d = *deques[worker % deques.size()];
+    QMutexLocker locker(&d.mutex);
+    if (d.items.empty()) {
+        return false;
+    }
+
+    item = std::move(d.items.front());
+    d.items.pop_front();
+    d.queuedBytes -= item.size;
+    itemTaken();
+    return true;
+}
+
+bool ScanQueue::steal(int worker, ScanItem& item)
+{
+    // Rob the deque with the most queued bytes, taking from the small end
+    // so its owner keeps working down its large files undisturbed.
+    int victim = -1;
+    qint64 mostBytes = -1;
+    for (size_t i = 0; i < deques.size(); ++i) {
+        if (int(i) == worker % int(deques.size())) {
+            continue;
+        }
+        QMutexLocker locker(&deques[i]->mutex);
+        if (!deques[i]->items.empty() && deques[i]->queuedBytes > mostBytes) {
+            mostBytes = deques[i]->queuedBytes;
+            victim = int(i);
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+
+    WorkerDeque& d = *deques[victim];
+    QMutexLocker locker(&d.mutex);
+    if (d.items.empty()) {
+        return false;
+    }
+
+    item = std::move(d.items.back());
+    d.items.pop_back();
+    d.queuedBytes -= item.size;
+    itemTaken();
+    return true;
+}
+
+// Called with the deque still locked, so queued always matches what the
+// deques hold and never drops below zero
+void ScanQueue::itemTaken()
+{
+    if (queued.fetchAndSubAcquire(1) == capacity) {
+        QMutexLocker locker(&stateMutex);
+        notFull.wakeAll();
+    }
+}
+
+void ScanQueue::close()
+{
+    QMutexLocker locker(&stateMutex);
+    closed = true;
+    notEmpty.wakeAll();
+}
+
+void ScanQueue::abort()
+{
+    QMutexLocker locker(&stateMutex);
+    aborted = true;
+    notEmpty.wakeAll();
+    notFull.wakeAll();
+}
+
+int ScanQueue::discovered() const
+{
+    QMutexLocker locker(&stateMutex);
+    return discoveredCount;
+}
+
+bool ScanQueue::isClosed() const
+{
+    QMutexLocker locker(&stateMutex);
+    return closed;
+}
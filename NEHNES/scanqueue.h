@@ -0,0 +1,67 @@
+#ifndef SCANQUEUE_H
+#define SCANQUEUE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+#include <deque>
+#include <memory>
+#include <vector>
+
+struct ScanItem
+{
+    QString path;
+    qint64 size = 0;
+};
+
+// Bounded scheduler between the directory walker and the scan workers.
+//
+// Every worker owns a deque kept in largest-first order, so huge archives
+// start early instead of being picked up last. Batches from the walker are
+// dealt to the deque with the fewest queued bytes, and a worker whose
+// deque runs dry steals the smallest items from the busiest one. The
+// walker blocks when the queue is full, so memory stays flat no matter how
+// many files the scanned tree holds.
+class ScanQueue
+{
+public:
+    explicit ScanQueue(int workers, int capacity = 4096);
+
+    bool push(QVector<ScanItem> batch);
+    bool pop(int worker, ScanItem& item);
+
+    // No more paths will be pushed; pop() drains what is left
+    void close();
+    // Stop immediately and wake every waiting thread
+    void abort();
+
+    int discovered() const;
+    bool isClosed() const;
+
+private:
+    struct WorkerDeque
+    {
+        QMutex mutex;
+        std::deque<ScanItem> items;
+        qint64 queuedBytes = 0;
+    };
+
+    std::vector<std::unique_ptr<WorkerDeque>> deques;
+
+    mutable QMutex stateMutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QAtomicInt queued;
+    int capacity;
+    int discoveredCount;
+    bool closed;
+    bool aborted;
+
+    bool takeOwn(int worker, ScanItem& item);
+    bool steal(int worker, ScanItem& item);
+    void itemTaken();
+};
+
+#endif // SCANQUEUE_H
@@ -0,0 +1,165 @@
+#include "scanresultmodel.h"
+#include <QDateTime>
+#include <QLocale>
+
+ScanResultModel::ScanResultModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+int ScanResultModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int ScanResultModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ScanResultModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.size()) {
+        return QVariant();
+    }
+
+    const ScanJob::Result& result = rows.at(index.row());
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case PathColumn:
+            return result.path;
+        case ThreatColumn:
+            return result.threatName;
+        case SizeColumn:
+            return QLocale().formattedDataSize(result.size);
+        case TimeColumn:
+            return QDateTime::fromMSecsSinceEpoch(result.detectedAt).toString("yyyy-MM-dd hh:mm:ss");
+        }
+    } else if (role == SortRole) {
+        switch (index.column()) {
+        case PathColumn:
+            return result.path;
+        case ThreatColumn:
+            return result.threatName;
+        case SizeColumn:
+            return result.size;
+        case TimeColumn:
+            return result.detectedAt;
+        }
+    } else if (role == Qt::ToolTipRole && index.column() == PathColumn) {
+        return result.path;
+    } else if (role == Qt::TextAlignmentRole && index.column() == SizeColumn) {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    return QVariant();
+}
+
+QVariant ScanResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (section) {
+    case PathColumn:
+        return QString("File");
+    case ThreatColumn:
+        return QString("Threat");
+    case SizeColumn:
+        return QString("Size");
+    case TimeColumn:
+        return QString("Detected");
+    }
+    return QVariant();
+}
+
+void ScanResultModel::addResults(const QVector<ScanJob::Result>& results)
+{
+    QVector<ScanJob::Result> fresh;
+    fresh.reserve(results.size());
+
+    for (const ScanJob::Result& result : results) {
+        auto it = rowByPath.constFind(result.path);
+        if (it != rowByPath.constEnd()) {
+            // Same file reported again (a rescan): refresh its row
+            if (*it >= rows.size()) {
+                fresh[*it - rows.size()] = result;
+            } else {
+                rows[*it] = result;
+                emit dataChanged(index(*it, 0), index(*it, ColumnCount - 1));
+            }
+            continue;
+        }
+        int pending = rows.size() + fresh.size();
+        rowByPath.insert(result.path, pending);
+        fresh.append(result);
+    }
+
+    if (fresh.isEmpty()) {
+        return;
+    }
+
+    // One insert notification per batch, not per row
+    beginInsertRows(QModelIndex(), rows.size(), rows.size() + fresh.size() - 1);
+    rows += fresh;
+    endInsertRows();
+}
+
+void ScanResultModel::removePaths(const QStringList& paths)
+{
+    QSet<QString> doomed;
+    for (const QString& path : paths) {
+        if (rowByPath.contains(path)) {
+            doomed.insert(path);
+        }
+    }
+    if (doomed.isEmpty()) {
+        return;
+    }
+
+    // Compact in a single pass instead of shifting the tail once per row
+    beginResetModel();
+    int kept = 0;
+    for (int i = 0; i < rows.size(); ++i) {
+        if (doomed.contains(rows.at(i).path)) {
+            continue;
+        }
+        if (kept != i) {
+            rows[kept] = std::move(rows[i]);
+        }
+        ++kept;
+    }
+    rows.resize(kept);
+
+    rowByPath.clear();
+    rowByPath.reserve(rows.size());
+    for (int i = 0; i < rows.size(); ++i) {
+        rowByPath.insert(rows.at(i).path, i);
+    }
+    endResetModel();
+}
+
+void ScanResultModel::clear()
+{
+    beginResetModel();
+    rows.clear();
+    rowByPath.clear();
+    endResetModel();
+}
+
+QString ScanResultModel::pathAt(int row) const
+{
+    return rows.value(row).path;
+}
+
+QStringList ScanResultModel::paths() const
+{
+    QStringList all;
+    all.reserve(rows.size());
+    for (const ScanJob::Result& result : rows) {
+        all.append(result.path);
+    }
+    return all;
+}
@@ -0,0 +1,52 @@
+#ifndef SCANRESULTMODEL_H
+#define SCANRESULTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include "scanjob.h"
+
+// Table of detections for the results view.
+//
+// Rows live in one flat vector with a path -> row index next to it, so new
+// batches are appended in O(batch), repeated hits on a path update their
+// row in place and deleting any number of files is one compaction pass.
+// The view only asks for the rows on screen, which keeps a million rows as
+// cheap to show as a hundred.
+class ScanResultModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        PathColumn,
+        ThreatColumn,
+        SizeColumn,
+        TimeColumn,
+        ColumnCount
+    };
+
+    // Unformatted value of a cell, used as the sort key
+    static constexpr int SortRole = Qt::UserRole;
+
+    explicit ScanResultModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void addResults(const QVector<ScanJob::Result>& results);
+    void removePaths(const QStringList& paths);
+    void clear();
+
+    QString pathAt(int row) const;
+    QStringList paths() const;
+
+private:
+    QVector<ScanJob::Result> rows;
+    QHash<QString, int> rowByPath;
+};
+
+#endif // SCANRESULTMODEL_H
@@ -1,19 +1,42 @@
-
-#include "settings.h"
-#include "ui_settings.h"
-
-Settings_H::Settings_H(QWidget *parent)
-    : QDialog(parent)
-    , ui(new Ui::Settings_H)
-{
-    ui->setupUi(this);  // Load the UI file
-
-    // Now you can access widgets from the .ui file like:
-    // ui->myButton, ui->myLabel, etc.
-}
-
-Settings_H::~Settings_H()
-{
-    delete ui;
-}
-
+
+#include "settings.h"
+#include "ui_settings.h"
+#include <QSettings>
+#include "directorywalker.h"
+
+Settings_H::Settings_H(QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::Settings_H)
+{
+    ui->setupUi(this);  // Load the UI file
+
+    QSettings settings;
+    ui->mirrorEdit->setText(settings.value("updates/mirror").toString());
+
+    ui->profileCombo->addItem("Full", "full");
+    ui->profileCombo->addItem("Balanced (no phishing signatures)", "balanced");
+    ui->profileCombo->addItem("Lite (daily signatures only, for small devices)", "lite");
+    int profile = ui->profileCombo->findData(settings.value("engine/profile", "full").toString());
+    ui->profileCombo->setCurrentIndex(qMax(0, profile));
+    ui->idleSpin->setValue(settings.value("engine/idleMinutes", 30).toInt());
+    ui->walkerSpin->setValue(settings.value("scan/walkerThreads",
+                                            DirectoryWalker::defaultThreadCount()).toInt());
+
+    connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &Settings_H::save);
+    connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+Settings_H::~Settings_H()
+{
+    delete ui;
+}
+
+void Settings_H::save()
+{
+    QSettings settings;
+    settings.setValue("updates/mirror", ui->mirrorEdit->text().trimmed());
+    settings.setValue("engine/profile", ui->profileCombo->currentData().toString());
+    settings.setValue("engine/idleMinutes", ui->idleSpin->value());
+    settings.setValue("scan/walkerThreads", ui->walkerSpin->value());
+    accept();
+}
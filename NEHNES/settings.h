@@ -1,24 +1,27 @@
-#ifndef SETTINGS_H
-#define SETTINGS_H
-
-#include <QDialog>
-
-
-namespace Ui {
-class Settings_H;  // Forward declaration
-}
-
-class Settings_H : public QDialog
-{
-    Q_OBJECT
-
-public:
-    explicit Settings_H(QWidget *parent = nullptr);
-    ~Settings_H();
-
-private:
-    Ui::Settings_H *ui;
-};
-
-#endif
-
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <QDialog>
+
+
+namespace Ui {
+class Settings_H;  // Forward declaration
+}
+
+class Settings_H : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit Settings_H(QWidget *parent = nullptr);
+    ~Settings_H();
+
+private slots:
+    void save();
+
+private:
+    Ui::Settings_H *ui;
+};
+
+#endif
+
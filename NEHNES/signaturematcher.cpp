@@ -0,0 +1,250 @@
+#include "signaturematcher.h"
+#include <algorithm>
+#include <utility>
+
+SignatureMatcher::SignatureMatcher()
+    : longestPattern(0)
+    , denseCount(1)
+    , dense(256, RootState)
+    , edgeStart(1, 0)
+    , fail(1, RootState)
+    , output(1, -1)
+    , outputLink(1, RootState)
+{
+}
+
+void SignatureMatcher::addSignature(const QString& name, const QByteArray& pattern)
+{
+    if (pattern.isEmpty()) {
+        return;
+    }
+
+    names.append(name);
+    patterns.push_back(pattern);
+    longestPattern = qMax(longestPattern, int(pattern.size()));
+}
+
+void SignatureMatcher::compile()
+{
+    // Plain trie first
+    struct Node
+    {
+        std::vector<std::pair<uchar, quint32>> next;
+        int pattern = -1;
+    };
+    std::vector<Node> trie(1);
+
+    auto child = [&trie](quint32 node, uchar byte) -> qint64 {
+        for (const auto& edge : trie[node].next) {
+            if (edge.first == byte) {
+                return edge.second;
+            }
+        }
+        return -1;
+    };
+
+    for (size_t id = 0; id < patterns.size(); ++id) {
+        quint32 node = 0;
+        for (char c : patterns[id]) {
+            uchar byte = uchar(c);
+            qint64 next = child(node, byte);
+            if (next < 0) {
+                next = qint64(trie.size());
+                trie[node].next.emplace_back(byte, quint32(next));
+                trie.emplace_back();
+            }
+            node = quint32(next);
+        }
+        if (trie[node].pattern < 0) {
+            trie[node].pattern = int(id);
+        }
+    }
+
+    // Breadth-first order gives failure links and the final state numbering
+    std::vector<quint32> order;
+    std::vector<quint32> trieFail(trie.size(), 0);
+    std::vector<quint32> trieLink(trie.size(), 0);
+    order.reserve(trie.size());
+    order.push_back(0);
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        quint32 node = order[i];
+        std::sort(trie[node].next.begin(), trie[node].next.end());
+
+        for (const auto& edge : trie[node].next) {
+            quint32 target = edge.second;
+            quint32 f = 0;
+            if (node != 0) {
+                f = trieFail[node];
+                qint64 next = child(f, edge.first);
+                while (next < 0 && f != 0) {
+                    f = trieFail[f];
+                    next = child(f, edge.first);
+                }
+                f = next >= 0 ? quint32(next) : 0;
+            }
+            trieFail[target] = f;
+            trieLink[target] = trie[f].pattern >= 0 ? f : trieLink[f];
+            order.push_back(target);
+        }
+    }
+
+    std::vector<quint32> renumber(trie.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        renumber[order[i]] = quint32(i);
+    }
+
+    const quint32 stateCount = quint32(order.size());
+    output.assign(stateCount, -1);
+    outputLink.assign(stateCount, RootState);
+    fail.assign(stateCount, RootState);
+    for (quint32 s = 0; s < stateCount; ++s) {
+        output[s] = trie[order[s]].pattern;
+        outputLink[s] = renumber[trieLink[order[s]]];
+        fail[s] = renumber[trieFail[order[s]]];
+    }
+
+    // Entering a flagged state completes at least one signature
+    auto flagged = [this](quint32 state) {
+        return output[state] >= 0 || outputLink[state] != RootState ? (state | OutputFlag) : state;
+    };
+
+    // Full rows for the hot shallow states; failure links always point to
+    // shallower states, whose rows are therefore already complete
+    denseCount = qMin(stateCount, MaxDenseStates);
+    dense.assign(size_t(denseCount) * 256, RootState);
+    for (quint32 s = 0; s < denseCount; ++s) {
+        const Node& node = trie[order[s]];
+        quint32 *row = &dense[size_t(s) * 256];
+        if (s != RootState) {
+            std::copy_n(&dense[size_t(fail[s]) * 256], 256, row);
+        }
+        for (const auto& edge : node.next) {
+            row[edge.first] = flagged(renumber[edge.second]);
+        }
+    }
+
+    edgeStart.assign(1, 0);
+    edgeBytes.clear();
+    edgeTargets.clear();
+    for (quint32 s = denseCount; s < stateCount; ++s) {
+        for (const auto& edge : trie[order[s]].next) {
+            edgeBytes.push_back(edge.first);
+            edgeTargets.push_back(flagged(renumber[edge.second]));
+        }
+        edgeStart.push_back(quint32(edgeBytes.size()));
+    }
+
+    skipAhead.build(patterns);
+}
+
+bool SignatureMatcher::isEmpty() const
+{
+    return patterns.empty();
+}
+
+int SignatureMatcher::signatureCount() const
+{
+    return int(patterns.size());
+}
+
+int SignatureMatcher::maxPatternLength() const
+{
+    return longestPattern;
+}
+
+const SignaturePrefilter& SignatureMatcher::prefilter() const
+{
+    return skipAhead;
+}
+
+QString SignatureMatcher::signatureName(int id) const
+{
+    return names.value(id);
+}
+
+qint64 SignatureMatcher::advance(const uchar *data, qint64 length, quint32& state) const
+{
+    quint32 s = state;
+
+    for (qint64 i = 0; i < length; ++i) {
+        // Bytes that cannot leave the root state are skipped in bulk
+        if (s == RootState) {
+            i = skipAhead.nextCandidate(data, i, length);
+            if (i >= length) {
+                break;
+            }
+        }
+
+        quint32 next = transition(s, data[i]);
+        s = next & StateMask;
+        if (next & OutputFlag) {
+            state = s;
+            return i + 1;
+        }
+    }
+
+    state = s;
+    return length;
+}
+
+SignatureMatcher::Stream::Stream(const SignatureMatcher& matcher)
+    : matcher(&matcher)
+    , state(RootState)
+    , offset(0)
+{
+}
+
+int SignatureMatcher::Stream::feed(const uchar *data, qint64 length, QVector<Match>& matches, int limit)
+{
+    int found = 0;
+    qint64 consumed = 0;
+
+    while (consumed < length && found < limit) {
+        consumed += matcher->advance(data + consumed, length - consumed, state);
+
+        // Report every signature ending here, longest first
+        quint32 s = matcher->output[state] >= 0 ? state : matcher->outputLink[state];
+        for (; s != RootState && found < limit; s = matcher->outputLink[s]) {
+            int id = matcher->output[s];
+            matches.append(Match{id, offset + consumed - qint64(matcher->patterns[id].size())});
+            ++found;
+        }
+    }
+
+    offset += consumed;
+    return found;
+}
+
+int SignatureMatcher::Stream::skipZeros(qint64 count, QVector<Match>& matches, int limit)
+{
+    static const uchar zeros[4096] = {};
+
+    // Once maxPatternLength() zeros have gone through, the state no longer
+    // depends on what came before the run, and more zeros cannot change it
+    qint64 needed = qMin<qint64>(count, matcher->maxPatternLength());
+    int found = 0;
+    while (needed > 0 && found < limit) {
+        qint64 step = qMin<qint64>(needed, sizeof(zeros));
+        qint64 before = offset;
+        found += feed(zeros, step, matches, limit - found);
+        needed -= offset - before;
+        count -= offset - before;
+    }
+
+    if (found < limit) {
+        offset += count;
+    }
+    return found;
+}
+
+qint64 SignatureMatcher::Stream::position() const
+{
+    return offset;
+}
+
+void SignatureMatcher::Stream::reset()
+{
+    state = RootState;
+    offset = 0;
+}
@@ -0,0 +1,106 @@
+#ifndef SIGNATUREMATCHER_H
+#define SIGNATUREMATCHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <vector>
+#include "signatureprefilter.h"
+
+// Aho-Corasick automaton over the built-in fallback signatures.
+//
+// All patterns are compiled into one automaton, so a file is searched for
+// every signature in a single pass. The first states in breadth-first order
+// (the root and its neighbourhood, where a scan of clean data spends almost
+// all of its time) get full 256-entry transition rows in one flat table.
+// Deeper states keep only their real edges and fall back along failure
+// links, which keeps memory proportional to the signature set.
+//
+// Input is fed through a Stream in chunks of any size. The automaton state
+// carries over from one chunk to the next, so matches straddling a chunk
+// boundary are found without buffering any overlap.
+class SignatureMatcher
+{
+public:
+    static constexpr quint32 RootState = 0;
+
+    struct Match
+    {
+        int signature;
+        qint64 offset;   // absolute offset of the first matching byte
+    };
+
+    class Stream
+    {
+    public:
+        explicit Stream(const SignatureMatcher& matcher);
+
+        // Feeds the next chunk and appends up to limit matches. Scanning
+        // stops at the limit, leaving the rest of the chunk unread.
+        int feed(const uchar *data, qint64 length, QVector<Match>& matches, int limit = 1);
+
+        // Advances over a run of zero bytes, such as a hole in a sparse file
+        int skipZeros(qint64 count, QVector<Match>& matches, int limit = 1);
+
+        qint64 position() const;
+        void reset();
+
+    private:
+        const SignatureMatcher *matcher;
+        quint32 state;
+        qint64 offset;
+    };
+
+    SignatureMatcher();
+
+    void addSignature(const QString& name, const QByteArray& pattern);
+    void compile();
+
+    bool isEmpty() const;
+    int signatureCount() const;
+    int maxPatternLength() const;
+    const SignaturePrefilter& prefilter() const;
+    QString signatureName(int id) const;
+
+
+private:
+    static constexpr quint32 OutputFlag = 0x80000000u;
+    static constexpr quint32 StateMask = 0x7fffffffu;
+    static constexpr quint32 MaxDenseStates = 1024;
+
+    QStringList names;
+    std::vector<QByteArray> patterns;
+    int longestPattern;
+
+    quint32 denseCount;
+    std::vector<quint32> dense;       // denseCount rows of 256 transitions
+    std::vector<quint32> edgeStart;   // sparse states: edge range per state
+    std::vector<uchar> edgeBytes;
+    std::vector<quint32> edgeTargets;
+    std::vector<quint32> fail;
+    std::vector<int> output;          // signature ending exactly at a state
+    std::vector<quint32> outputLink;  // next shorter suffix state with a signature
+    SignaturePrefilter skipAhead;
+
+    // Consumes bytes up to and including the first one that completes a
+    // signature; returns how many bytes were consumed
+    qint64 advance(const uchar *data, qint64 length, quint32& state) const;
+
+    inline quint32 transition(quint32 state, uchar byte) const
+    {
+        while (state >= denseCount) {
+            quint32 begin = edgeStart[state - denseCount];
+            quint32 end = edgeStart[state - denseCount + 1];
+            for (quint32 e = begin; e < end; ++e) {
+                if (edgeBytes[e] == byte) {
+                    return edgeTargets[e];
+                }
+            }
+            state = fail[state];
+        }
+        return dense[state * 256 + byte];
+    }
+};
+
+#endif // SIGNATUREMATCHER_H
@@ -0,0 +1,224 @@
+#include "signatureprefilter.h"
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define NEHNES_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef NEHNES_X86_SIMD
+bool cpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// Past this many distinct start bytes most of the input is a candidate and
+// the prefilter only adds overhead
+const int MaxUsefulStartBytes = 128;
+
+}
+
+SignaturePrefilter::SignaturePrefilter()
+    : implementation(Scalar)
+    , useful(false)
+    , startCount(0)
+    , compareBytes()
+    , shuffleLow()
+    , shuffleHigh()
+    , startBytes()
+    , singleBytes()
+{
+}
+
+void SignaturePrefilter::build(const std::vector<QByteArray>& patterns)
+{
+    *this = SignaturePrefilter();
+    pairs.assign(65536 / 64, 0);
+
+    for (const QByteArray& pattern : patterns) {
+        if (pattern.isEmpty()) {
+            continue;
+        }
+        uchar first = uchar(pattern[0]);
+        startBytes[first >> 6] |= quint64(1) << (first & 63);
+        if (pattern.size() == 1) {
+            singleBytes[first >> 6] |= quint64(1) << (first & 63);
+        } else {
+            quint32 pair = (quint32(first) << 8) | uchar(pattern[1]);
+            pairs[pair >> 6] |= quint64(1) << (pair & 63);
+        }
+    }
+
+    int distinct = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (!isStart(uchar(b))) {
+            continue;
+        }
+        if (distinct < MaxCompareBytes) {
+            compareBytes[distinct] = uchar(b);
+        }
+        // Nibble tables for the shuffle-based class test: every start byte
+        // lands in one of eight buckets picked by its high nibble
+        uchar bucket = uchar(1u << ((b >> 4) & 7));
+        shuffleLow[b & 15] |= bucket;
+        shuffleHigh[b >> 4] |= bucket;
+        ++distinct;
+    }
+
+    startCount = distinct;
+    useful = distinct > 0 && distinct <= MaxUsefulStartBytes;
+    for (int i = qMin(distinct, MaxCompareBytes); i < MaxCompareBytes && distinct > 0; ++i) {
+        compareBytes[i] = compareBytes[0];
+    }
+
+#ifdef NEHNES_X86_SIMD
+    static const bool avx2 = cpuHasAvx2();
+    if (avx2) {
+        implementation = Avx2;
+    } else if (distinct <= MaxCompareBytes) {
+        implementation = Sse2;
+    }
+#endif
+}
+
+qint64 SignaturePrefilter::nextCandidate(const uchar *data, qint64 from, qint64 length) const
+{
+    if (!useful) {
+        return from;
+    }
+
+    switch (implementation) {
+    case Avx2:
+        return scanAvx2(data, from, length);
+    case Sse2:
+        return scanSse2(data, from, length);
+    case Scalar:
+        break;
+    }
+    return scanScalar(data, from, length);
+}
+
+bool SignaturePrefilter::isUseful() const
+{
+    return useful;
+}
+
+const char *SignaturePrefilter::implementationName() const
+{
+    switch (implementation) {
+    case Avx2:
+        return "AVX2";
+    case Sse2:
+        return "SSE2";
+    case Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+qint64 SignaturePrefilter::scanScalar(const uchar *data, qint64 from, qint64 length) const
+{
+    for (qint64 i = from; i < length; ++i) {
+        if (isCandidate(data, i, length)) {
+            return i;
+        }
+    }
+    return length;
+}
+
+#ifdef NEHNES_X86_SIMD
+
+qint64 SignaturePrefilter::scanSse2(const uchar *data, qint64 from, qint64 length) const
+{
+    const __m128i n0 = _mm_set1_epi8(char(compareBytes[0]));
+    const __m128i n1 = _mm_set1_epi8(char(compareBytes[1]));
+    const __m128i n2 = _mm_set1_epi8(char(compareBytes[2]));
+    const __m128i n3 = _mm_set1_epi8(char(compareBytes[3]));
+
+    qint64 i = from;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, n0), _mm_cmpeq_epi8(v, n1)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, n2), _mm_cmpeq_epi8(v, n3)));
+        unsigned mask = unsigned(_mm_movemask_epi8(hit));
+        while (mask) {
+            qint64 pos = i + __builtin_ctz(mask);
+            if (isCandidate(data, pos, length)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scanScalar(data, i, length);
+}
+
+__attribute__((target("avx2")))
+qint64 SignaturePrefilter::scanAvx2(const uchar *data, qint64 from, qint64 length) const
+{
+    qint64 i = from;
+
+    if (startCount <= MaxCompareBytes) {
+        // Few start bytes: plain equality tests
+        const __m256i n0 = _mm256_set1_epi8(char(compareBytes[0]));
+        const __m256i n1 = _mm256_set1_epi8(char(compareBytes[1]));
+        const __m256i n2 = _mm256_set1_epi8(char(compareBytes[2]));
+        const __m256i n3 = _mm256_set1_epi8(char(compareBytes[3]));
+
+        for (; i + 32 <= length; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hit = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, n0), _mm256_cmpeq_epi8(v, n1)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, n2), _mm256_cmpeq_epi8(v, n3)));
+            unsigned mask = unsigned(_mm256_movemask_epi8(hit));
+            while (mask) {
+                qint64 pos = i + __builtin_ctz(mask);
+                if (isCandidate(data, pos, length)) {
+                    return pos;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return scanScalar(data, i, length);
+    }
+
+    // Many start bytes: classify every byte through two nibble lookups
+    const __m256i low = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleLow)));
+    const __m256i high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleHigh)));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i lo = _mm256_shuffle_epi8(low, _mm256_and_si256(v, nibble));
+        __m256i hi = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), zero);
+        unsigned mask = ~unsigned(_mm256_movemask_epi8(miss));
+        while (mask) {
+            qint64 pos = i + __builtin_ctz(mask);
+            if (isCandidate(data, pos, length)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scanScalar(data, i, length);
+}
+
+#else
+
+qint64 SignaturePrefilter::scanSse2(const uchar *data, qint64 from, qint64 length) const
+{
+    return scanScalar(data, from, length);
+}
+
+qint64 SignaturePrefilter::scanAvx2(const uchar *data, qint64 from, qint64 length) const
+{
+    return scanScalar(data, from, length);
+}
+
+#endif
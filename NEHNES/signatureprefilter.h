@@ -0,0 +1,67 @@
+#ifndef SIGNATUREPREFILTER_H
+#define SIGNATUREPREFILTER_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <vector>
+
+// Vectorized skip-ahead in front of the SignatureMatcher automaton.
+//
+// While the automaton sits in its root state, no byte that cannot start a
+// signature can change that, so the prefilter jumps straight to the next
+// offset whose byte starts some signature and whose following byte also
+// fits that signature's first two bytes. The byte search uses AVX2 or SSE2,
+// picked at runtime from the CPU, with a scalar loop everywhere else.
+class SignaturePrefilter
+{
+public:
+    SignaturePrefilter();
+
+    void build(const std::vector<QByteArray>& patterns);
+
+    // First offset in [from, length) the automaton has to look at from its
+    // root state, or length if there is none
+    qint64 nextCandidate(const uchar *data, qint64 from, qint64 length) const;
+
+    bool isUseful() const;
+    const char *implementationName() const;
+
+private:
+    enum Implementation { Scalar, Sse2, Avx2 };
+
+    static constexpr int MaxCompareBytes = 4;
+
+    Implementation implementation;
+    bool useful;
+    int startCount;
+    uchar compareBytes[MaxCompareBytes];
+    uchar shuffleLow[16];
+    uchar shuffleHigh[16];
+    quint64 startBytes[4];
+    quint64 singleBytes[4];
+    std::vector<quint64> pairs;   // 65536-bit set of valid first byte pairs
+
+    inline bool isStart(uchar b) const
+    {
+        return startBytes[b >> 6] & (quint64(1) << (b & 63));
+    }
+
+    inline bool isCandidate(const uchar *data, qint64 pos, qint64 length) const
+    {
+        uchar first = data[pos];
+        if (!isStart(first)) {
+            return false;
+        }
+        if (pos + 1 >= length || (singleBytes[first >> 6] & (quint64(1) << (first & 63)))) {
+            return true;
+        }
+        quint32 pair = (quint32(first) << 8) | data[pos + 1];
+        return pairs[pair >> 6] & (quint64(1) << (pair & 63));
+    }
+
+    qint64 scanScalar(const uchar *data, qint64 from, qint64 length) const;
+    qint64 scanSse2(const uchar *data, qint64 from, qint64 length) const;
+    qint64 scanAvx2(const uchar *data, qint64 from, qint64 length) const;
+};
+
+#endif // SIGNATUREPREFILTER_H
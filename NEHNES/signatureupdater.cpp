@@ -0,0 +1,241 @@
+#include "signatureupdater.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
+#include <QVector>
+#include <clamav.h>
+
+#ifdef HAVE_FRESHCLAM
+#include <libfreshclam.h>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <cstdio>
+#endif
+
+SignatureUpdater::SignatureUpdater(const QString& mirror, const QString& databaseDirectory)
+    : mirror(mirror.trimmed())
+    , databaseDir(databaseDirectory)
+{
+}
+
+QStringList SignatureUpdater::databases()
+{
+    return {"main", "daily", "bytecode"};
+}
+
+bool SignatureUpdater::mirrorIsLocal() const
+{
+    QUrl url(mirror);
+    return url.isLocalFile() || url.scheme().isEmpty() || QDir::isAbsolutePath(mirror);
+}
+
+QString SignatureUpdater::mirrorDirectory() const
+{
+    QUrl url(mirror);
+    return url.isLocalFile() ? url.toLocalFile() : mirror;
+}
+
+SignatureUpdater::Report SignatureUpdater::run()
+{
+    Report report;
+    if (mirror.isEmpty()) {
+        report.error = "No update mirror configured";
+        return report;
+    }
+    if (!QDir().mkpath(databaseDir)) {
+        report.error = QString("Cannot create database directory %1").arg(databaseDir);
+        return report;
+    }
+
+#ifdef HAVE_FRESHCLAM
+    return runFreshclam();
+#else
+    if (mirrorIsLocal()) {
+        return copyFromLocalMirror();
+    }
+    report.error = "Updating from a URL needs libfreshclam, which this build does not include";
+    return report;
+#endif
+}
+
+unsigned int SignatureUpdater::localVersion(const QString& directory, const QString& database)
+{
+    // freshclam keeps patched databases as .cld, pristine downloads as .cvd
+    for (const QString& suffix : {QString(".cld"), QString(".cvd")}) {
+        QString path = QDir(directory).filePath(database + suffix);
+        if (!QFileInfo::exists(path)) {
+            continue;
+        }
+        struct cl_cvd *head = cl_cvdhead(QFile::encodeName(path).constData());
+        if (head) {
+            unsigned int version = head->version;
+            cl_cvdfree(head);
+            return version;
+        }
+    }
+    return 0;
+}
+
+qint64 SignatureUpdater::patchBytes(const QString& database, unsigned int from, unsigned int to) const
+{
+    // Size of what the update pulled from a local mirror: the chain of
+    // patches if it is complete, the full database otherwise
+    QDir dir(mirrorDirectory());
+    qint64 total = 0;
+    for (unsigned int version = from + 1; version <= to; ++version) {
+        QFileInfo patch(dir.filePath(QString("%1-%2.cdiff").arg(database).arg(version)));
+        if (!patch.exists()) {
+            return QFileInfo(dir.filePath(database + ".cvd")).size();
+        }
+        total += patch.size();
+    }
+    return total;
+}
+
+SignatureUpdater::Report SignatureUpdater::runFreshclam()
+{
+    Report report;
+#ifdef HAVE_FRESHCLAM
+    QByteArray dbDir = QFile::encodeName(QDir::toNativeSeparators(databaseDir));
+    QByteArray tempDir = QFile::encodeName(QDir::toNativeSeparators(QDir::tempPath()));
+    QByteArray server = (mirrorIsLocal() ? QUrl::fromLocalFile(mirrorDirectory()).toString()
+                                         : mirror).toUtf8();
+
+    fc_config config = {};
+    config.maxAttempts = 3;
+    config.connectTimeout = 30;
+    config.requestTimeout = 60;
+    config.databaseDirectory = dbDir.constData();
+    config.tempDirectory = tempDir.constData();
+    config.userAgent = "NEHNES";
+
+    fc_error_t ret = fc_initialize(&config);
+    if (ret != FC_SUCCESS) {
+        report.error = QString("Failed to initialize libfreshclam: %1").arg(fc_strerror(ret));
+        return report;
+    }
+
+    QList<unsigned int> before;
+    for (const QString& database : databases()) {
+        before.append(localVersion(databaseDir, database));
+    }
+
+    QList<QByteArray> names;
+    QVector<char*> databaseList;
+    for (const QString& database : databases()) {
+        names.append(database.toUtf8());
+        databaseList.append(names.last().data());
+    }
+    char *serverList[] = {server.data()};
+    uint32_t updatedCount = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    // Private mirror with scripted updates: fetch and apply .cdiff patches,
+    // falling back to full downloads only where the chain is broken
+    ret = fc_update_databases(databaseList.data(), uint32_t(databaseList.size()),
+                              serverList, 1, 1, dbDir.constData(), nullptr, 1,
+                              nullptr, &updatedCount);
+    report.applyMs = timer.elapsed();
+    fc_cleanup();
+
+    if (ret != FC_SUCCESS && ret != FC_UPTODATE) {
+        report.error = QString("Signature update failed: %1").arg(fc_strerror(ret));
+        return report;
+    }
+
+    bool countable = mirrorIsLocal();
+    report.transferBytes = 0;
+    for (int i = 0; i < databases().size(); ++i) {
+        unsigned int after = localVersion(databaseDir, databases().at(i));
+        if (after == before.at(i)) {
+            continue;
+        }
+        report.updated.append(QString("%1 %2 -> %3").arg(databases().at(i)).arg(before.at(i)).arg(after));
+        if (countable) {
+            report.transferBytes += patchBytes(databases().at(i), before.at(i), after);
+        }
+    }
+    if (!countable) {
+        report.transferBytes = -1;
+    }
+    report.ok = true;
+#endif
+    return report;
+}
+
+SignatureUpdater::Report SignatureUpdater::copyFromLocalMirror()
+{
+    Report report;
+    QDir source(mirrorDirectory());
+    if (!source.exists()) {
+        report.error = QString("Mirror directory %1 does not exist").arg(source.path());
+        return report;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    report.transferBytes = 0;
+    // Applying .cdiff patches takes libfreshclam; this path only ever
+    // copies whole databases
+    report.fullDatabasesOnly = true;
+
+    for (const QString& database : databases()) {
+        QString incoming = source.filePath(database + ".cvd");
+        if (!QFileInfo::exists(incoming)) {
+            continue;
+        }
+
+        unsigned int current = localVersion(databaseDir, database);
+        unsigned int offered = localVersion(source.path(), database);
+        if (offered <= current) {
+            continue;
+        }
+
+        // Never replace a working database with one that fails its signature
+        cl_error_t ret = cl_cvdverify(QFile::encodeName(incoming).constData());
+        if (ret != CL_SUCCESS) {
+            report.error = QString("%1.cvd from the mirror failed verification: %2")
+                               .arg(database).arg(cl_strerror(ret));
+            return report;
+        }
+
+        // Copy next to the target and rename over it, so a scan reloading
+        // the directory never sees a half-written file, or no file at all
+        QDir target(databaseDir);
+        QString staging = target.filePath(database + ".cvd.part");
+        QString installed = target.filePath(database + ".cvd");
+        QFile::remove(staging);
+        if (!QFile::copy(incoming, staging)) {
+            report.error = QString("Failed to copy %1.cvd").arg(database);
+            return report;
+        }
+#ifdef Q_OS_UNIX
+        // rename() replaces the old database in one step
+        bool replaced = ::rename(QFile::encodeName(staging).constData(),
+                                 QFile::encodeName(installed).constData()) == 0;
+#else
+        // QFile::rename() will not overwrite; keep the gap as short as we can
+        QFile::remove(installed);
+        bool replaced = QFile::rename(staging, installed);
+#endif
+        if (!replaced) {
+            QFile::remove(staging);
+            report.error = QString("Failed to install %1.cvd").arg(database);
+            return report;
+        }
+        // A patched copy left by freshclam is older than what we just
+        // installed; only now is it safe to drop
+        QFile::remove(target.filePath(database + ".cld"));
+
+        report.transferBytes += QFileInfo(incoming).size();
+        report.updated.append(QString("%1 %2 -> %3").arg(database).arg(current).arg(offered));
+    }
+
+    report.applyMs = timer.elapsed();
+    report.ok = true;
+    return report;
+}
@@ -0,0 +1,53 @@
+#ifndef SIGNATUREUPDATER_H
+#define SIGNATUREUPDATER_H
+
+#include <QString>
+#include <QStringList>
+
+// Brings the local ClamAV databases up to date from a mirror.
+//
+// The mirror is an http(s) URL laid out like database.clamav.net, or a
+// local directory holding the same files (handy for testing and for
+// sneakernet updates). With libfreshclam available, updates are applied as
+// incremental .cdiff patches, which libfreshclam verifies and test-loads
+// before replacing anything; it only downloads a full .cvd when the patch
+// chain is broken. Without it, a local mirror can still provide newer full
+// databases, which are verified with cl_cvdverify before being copied in;
+// any .cdiff patches in it are ignored, so every update is a full download.
+// Either way a database is replaced with one atomic rename, so a reload
+// sees the old version or the new one, never neither.
+class SignatureUpdater
+{
+public:
+    struct Report
+    {
+        bool ok = false;
+        QString error;
+        QStringList updated;      // databases that changed, e.g. "daily 27001 -> 27004"
+        qint64 transferBytes = -1; // -1 when the transport cannot tell
+        qint64 applyMs = 0;
+        bool fullDatabasesOnly = false; // .cdiff patches were not considered (no libfreshclam)
+    };
+
+    SignatureUpdater(const QString& mirror, const QString& databaseDirectory);
+
+    // Blocking; run it off the GUI thread
+    Report run();
+
+    static QStringList databases();
+
+private:
+    QString mirror;
+    QString databaseDir;
+
+    bool mirrorIsLocal() const;
+    QString mirrorDirectory() const;
+
+    Report runFreshclam();
+    Report copyFromLocalMirror();
+
+    static unsigned int localVersion(const QString& directory, const QString& database);
+    qint64 patchBytes(const QString& database, unsigned int from, unsigned int to) const;
+};
+
+#endif // SIGNATUREUPDATER_H
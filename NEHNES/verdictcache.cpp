@@ -0,0 +1,307 @@
+#include "verdictcache.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+const quint32 CacheMagic = 0x4e564332; // "NVC2"
+
+// Files no scan has come across for this long are most likely gone
+const quint32 MaxAgeDays = 60;
+// Roughly 60 MB in memory; past this the longest unseen entries go
+const int MaxEntries = 1000000;
+}
+
+FileIdentity FileIdentity::of(const QString& filePath)
+{
+    FileIdentity id;
+
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0) {
+        return id;
+    }
+
+    id.device = quint64(st.st_dev);
+    id.inode = quint64(st.st_ino);
+    id.size = qint64(st.st_size);
+#ifdef Q_OS_LINUX
+    id.modified = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    id.changed = qint64(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+#else
+    id.modified = qint64(st.st_mtime) * 1000000000;
+    id.changed = qint64(st.st_ctime) * 1000000000;
+#endif
+#else
+    // No inode numbers through QFileInfo; the path hash stands in for one
+    QFileInfo info(filePath);
+    if (!info.exists()) {
+        return id;
+    }
+
+    id.inode = quint64(qHash(info.absoluteFilePath()));
+    id.size = info.size();
+    id.modified = info.lastModified().toMSecsSinceEpoch();
+    id.changed = info.metadataChangeTime().toMSecsSinceEpoch();
+#endif
+
+    id.valid = true;
+    return id;
+}
+
+VerdictCache::VerdictCache(const QString& cacheFile)
+    : filePath(cacheFile)
+    , dbVersion(0)
+    , today(0)
+    , dirty(0)
+{
+}
+
+QString VerdictCache::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/verdicts.cache";
+}
+
+VerdictCache::Shard& VerdictCache::shardFor(const Key& key)
+{
+    return shards[qHash(key) % ShardCount];
+}
+
+void VerdictCache::lockAll()
+{
+    // Always in the same order, so two callers cannot deadlock
+    for (Shard& shard : shards) {
+        shard.lock.lockForWrite();
+    }
+}
+
+void VerdictCache::unlockAll()
+{
+    for (Shard& shard : shards) {
+        shard.lock.unlock();
+    }
+}
+
+void VerdictCache::load(quint64 databaseVersion)
+{
+    lockAll();
+    for (Shard& shard : shards) {
+        shard.entries.clear();
+    }
+    dbVersion = databaseVersion;
+    today = quint32(QDateTime::currentSecsSinceEpoch() / 86400);
+
+    // A cache for another database (or a damaged one) is replaced on save
+    bool loaded = read();
+    if (!loaded) {
+        for (Shard& shard : shards) {
+            shard.entries.clear();
+        }
+    }
+    dirty.storeRelaxed(!loaded && QFile::exists(filePath));
+    unlockAll();
+}
+
+bool VerdictCache::read()
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint64 version = 0;
+    quint32 count = 0;
+    in >> magic >> version >> count;
+
+    // Verdicts from another signature database say nothing about this one
+    if (magic != CacheMagic || version != dbVersion) {
+        return false;
+    }
+
+    for (quint32 i = 0; i < count; ++i) {
+        Key key;
+        qint64 size, modified, changed;
+        quint32 seenDay;
+        in >> key.first >> key.second >> size >> modified >> changed >> seenDay;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        merge(key, Entry{size, modified, changed, seenDay});
+    }
+    return true;
+}
+
+bool VerdictCache::save()
+{
+    if (!dirty.loadRelaxed()) {
+        return true;
+    }
+
+    lockAll();
+    bool saved = write();
+    unlockAll();
+    return saved;
+}
+
+bool VerdictCache::write()
+{
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    // Other front ends may have saved since we loaded; keep what they added
+    // instead of overwriting it, and keep them out until we are done
+    QLockFile fileLock(filePath + ".lock");
+    if (!fileLock.tryLock(10000)) {
+        return false;
+    }
+
+    read();
+    prune();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << CacheMagic << dbVersion << quint32(count());
+    for (const Shard& shard : shards) {
+        for (auto it = shard.entries.constBegin(); it != shard.entries.constEnd(); ++it) {
+            out << it.key().first << it.key().second
+                << it.value().size << it.value().modified << it.value().changed
+                << it.value().seenDay.loadRelaxed();
+        }
+    }
+
+    if (!file.commit()) {
+        return false;
+    }
+    dirty.storeRelaxed(0);
+    return true;
+}
+
+void VerdictCache::merge(const Key& key, const Entry& entry)
+{
+    QHash<Key, Entry>& entries = shardFor(key).entries;
+    auto mine = entries.find(key);
+    if (mine == entries.end()) {
+        entries.insert(key, entry);
+    } else if (entry.seenDay.loadRelaxed() > mine->seenDay.loadRelaxed()) {
+        // Whoever came across the file last knows what it looks like now
+        *mine = entry;
+    }
+}
+
+int VerdictCache::count() const
+{
+    int total = 0;
+    for (const Shard& shard : shards) {
+        total += int(shard.entries.size());
+    }
+    return total;
+}
+
+void VerdictCache::prune()
+{
+    const quint32 oldest = today > MaxAgeDays ? today - MaxAgeDays : 0;
+    for (Shard& shard : shards) {
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (it->seenDay.loadRelaxed() < oldest) {
+                it = shard.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    int excess = count() - MaxEntries;
+    if (excess <= 0) {
+        return;
+    }
+
+    // Still over the cap: find the day that splits off the excess, then
+    // drop everything seen before it and as much of that day as needed
+    std::vector<quint32> days;
+    days.reserve(size_t(count()));
+    for (const Shard& shard : shards) {
+        for (auto it = shard.entries.constBegin(); it != shard.entries.constEnd(); ++it) {
+            days.push_back(it->seenDay.loadRelaxed());
+        }
+    }
+    std::nth_element(days.begin(), days.begin() + excess, days.end());
+    const quint32 cutoff = days[size_t(excess)];
+
+    for (bool sameDay : {false, true}) {
+        for (Shard& shard : shards) {
+            for (auto it = shard.entries.begin(); it != shard.entries.end() && excess > 0;) {
+                quint32 day = it->seenDay.loadRelaxed();
+                if (day < cutoff || (sameDay && day == cutoff)) {
+                    it = shard.entries.erase(it);
+                    --excess;
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+}
+
+bool VerdictCache::isKnownClean(const FileIdentity& id)
+{
+    if (id.valid) {
+        Key key(id.device, id.inode);
+        Shard& shard = shardFor(key);
+        QReadLocker locker(&shard.lock);
+        auto it = shard.entries.constFind(key);
+        if (it != shard.entries.constEnd()
+            && it->size == id.size
+            && it->modified == id.modified
+            && it->changed == id.changed) {
+            // Still around, so not up for pruning; written at most once a day
+            if (it->seenDay.loadRelaxed() != today) {
+                it->seenDay.storeRelaxed(today);
+                dirty.storeRelaxed(1);
+            }
+            hitCount.fetchAndAddRelaxed(1);
+            return true;
+        }
+    }
+
+    missCount.fetchAndAddRelaxed(1);
+    return false;
+}
+
+void VerdictCache::markClean(const FileIdentity& id)
+{
+    if (!id.valid) {
+        return;
+    }
+
+    Key key(id.device, id.inode);
+    Shard& shard = shardFor(key);
+    QWriteLocker locker(&shard.lock);
+    shard.entries.insert(key, Entry{id.size, id.modified, id.changed, today});
+    dirty.storeRelaxed(1);
+}
+
+int VerdictCache::hits() const
+{
+    return hitCount.loadRelaxed();
+}
+
+int VerdictCache::misses() const
+{
+    return missCount.loadRelaxed();
+}
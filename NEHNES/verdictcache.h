@@ -0,0 +1,100 @@
+#ifndef VERDICTCACHE_H
+#define VERDICTCACHE_H
+
+#include <QHash>
+#include <QPair>
+#include <QReadWriteLock>
+#include <QAtomicInt>
+#include <QString>
+
+// Identity of a file as far as the verdict cache is concerned. Any change
+// to the contents bumps the size or one of the timestamps.
+struct FileIdentity
+{
+    quint64 device = 0;
+    quint64 inode = 0;
+    qint64 size = 0;
+    qint64 modified = 0;
+    qint64 changed = 0;
+    bool valid = false;
+
+    static FileIdentity of(const QString& filePath);
+};
+
+// On-disk cache of clean verdicts, so unchanged files are not rescanned on
+// every run. The whole cache is tied to one signature database version and
+// is thrown away when a different database is loaded.
+//
+// The GUI, nehnes-scan and nehnes-scand share one file. save() merges what
+// is on disk under a lock file before writing, so one of them saving does
+// not drop what another has added. Entries for files no scan has seen in a
+// while (deleted or replaced inodes, trees nobody scans any more) are
+// pruned on save, and the oldest go first once the cache is full.
+//
+// Every scan worker looks up and records verdicts concurrently, so the
+// table is split into shards by inode, each behind its own lock: a clean
+// verdict only blocks the workers that hit the same shard. load() and
+// save() lock every shard.
+class VerdictCache
+{
+public:
+    explicit VerdictCache(const QString& cacheFile = defaultPath());
+
+    static QString defaultPath();
+
+    void load(quint64 databaseVersion);
+    bool save();
+
+    bool isKnownClean(const FileIdentity& id);
+    void markClean(const FileIdentity& id);
+
+    int hits() const;
+    int misses() const;
+
+private:
+    struct Entry
+    {
+        qint64 size;
+        qint64 modified;
+        qint64 changed;
+        // Day (since the epoch) a scan last came across the file; hits
+        // bump it under the read lock
+        mutable QAtomicInteger<quint32> seenDay;
+    };
+
+    typedef QPair<quint64, quint64> Key;
+
+    static const int ShardCount = 32;
+
+    // A cache line each, so workers on different shards do not contend
+    // for the lock words either
+    struct alignas(64) Shard
+    {
+        QReadWriteLock lock;
+        QHash<Key, Entry> entries;
+    };
+
+    QString filePath;
+    quint64 dbVersion;
+    quint32 today;
+    Shard shards[ShardCount];
+    QAtomicInt hitCount;
+    QAtomicInt missCount;
+    QAtomicInt dirty;
+
+    Shard& shardFor(const Key& key);
+    void lockAll();
+    void unlockAll();
+
+    // The rest expect every shard to be locked
+
+    // Merges the cache file into the table; false if it is missing,
+    // damaged or was written for another database version
+    bool read();
+    bool write();
+    void merge(const Key& key, const Entry& entry);
+    void prune();
+    int count() const;
+};
+
+#endif // VERDICTCACHE_H